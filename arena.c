@@ -0,0 +1,84 @@
+// The arena: one block of memory, taken at startup, which every game buffer
+// is carved out of.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "arena.h"
+
+#include <assert.h>  // assert
+#include <stdlib.h>  // aligned_alloc, free
+#include <string.h>  // memset
+#include <sys/resource.h>  // getrusage
+
+
+// Return the space arenaAlloc() takes for a buffer of the given size.
+size_t arenaRound(size_t bytes) {
+    return (bytes + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+
+// Allocate an arena of the given size, as one block.
+void arenaInit(Arena* arenap, size_t size) {
+    size = arenaRound(size > 0 ? size : 1);
+    arenap->basep = aligned_alloc(ARENA_ALIGN, size);
+    assert(arenap->basep != NULL);
+    arenap->size = size;
+    arenap->used = 0;
+    arenap->peak = 0;
+    arenap->sealed = false;
+}
+
+
+// Take a zeroed buffer from the arena.  It must fit, and the arena must not
+// be sealed.
+void* arenaAlloc(Arena* arenap, size_t bytes) {
+    assert(arenap->sealed == false);
+    size_t rounded = arenaRound(bytes);
+    assert(rounded <= arenap->size - arenap->used);
+    void* p = arenap->basep + arenap->used;
+    memset(p, 0, bytes);
+    arenap->used += rounded;
+    if (arenap->used > arenap->peak) {
+        arenap->peak = arenap->used;
+    }
+    return p;
+}
+
+
+// Refuse any further allocation, until the arena is reset.
+void arenaSeal(Arena* arenap) {
+    arenap->sealed = true;
+}
+
+
+// Give back every buffer at once.  Their memory is reused by the next
+// allocations, without being freed.
+void arenaReset(Arena* arenap) {
+    arenap->used = 0;
+    arenap->sealed = false;
+}
+
+
+// Free the arena, and every buffer in it.
+void arenaFree(Arena* arenap) {
+    free(arenap->basep);
+    arenap->basep = NULL;
+    arenap->size = 0;
+    arenap->used = 0;
+}
+
+
+// Return the peak resident set size of the process, in kilobytes.
+long peakRssKb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    // kilobytes on Linux.
+    return usage.ru_maxrss;
+}
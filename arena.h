@@ -0,0 +1,62 @@
+// The arena: one block of memory, taken at startup, which every game buffer
+// is carved out of.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// Each buffer starts on a cache line of its own, so that buffers used by
+// different threads or for different things never share a line.  Nothing is
+// freed on its own: the whole arena is reset at once, by moving the top back
+// to the start, or freed at once.  Once sealed, the arena refuses every
+// allocation, which is how the game makes sure nothing allocates after
+// startup.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>  // uint8_t
+#include <stddef.h>  // size_t
+#include <stdbool.h>  // bool
+
+#define ARENA_ALIGN 64  // a cache line.
+
+
+// An arena, and how much of it is in use.
+struct _Arena {
+    uint8_t* basep;
+    size_t size;
+    size_t used;
+    size_t peak;  // the most ever used at once.
+    bool sealed;
+};
+typedef struct _Arena Arena;
+
+
+// Return the space arenaAlloc() takes for a buffer of the given size.
+size_t arenaRound(size_t bytes);
+
+// Allocate an arena of the given size, as one block.
+void arenaInit(Arena* arenap, size_t size);
+
+// Take a zeroed buffer from the arena.  It must fit, and the arena must not
+// be sealed.
+void* arenaAlloc(Arena* arenap, size_t bytes);
+
+// Refuse any further allocation, until the arena is reset.
+void arenaSeal(Arena* arenap);
+
+// Give back every buffer at once.  Their memory is reused by the next
+// allocations, without being freed.
+void arenaReset(Arena* arenap);
+
+// Free the arena, and every buffer in it.
+void arenaFree(Arena* arenap);
+
+// Return the peak resident set size of the process, in kilobytes.
+long peakRssKb(void);
+
+#endif
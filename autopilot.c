@@ -0,0 +1,214 @@
+// The autopilot: steers the snake by itself, for attract mode and testing.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "autopilot.h"
+
+#include <string.h>  // memset
+#include <time.h>  // clock_gettime
+
+// how many cells to expand between looks at the clock.
+#define CELLS_PER_CLOCK_CHECK 32
+
+
+// Return the nanoseconds elapsed since an arbitrary point.
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Find the cell one block away in direction.  Returns false if that is off
+// the board; on a level which wraps round, it never is.
+static bool neighbour(State* statep, int x, int y, uint8_t direction, int* nxp, int* nyp) {
+    SnakeNode node = {x, y};
+    stepOnBoard(statep, &node, direction);
+    *nxp = node.x;
+    *nyp = node.y;
+    return node.x != OFF_BOARD && node.y != OFF_BOARD;
+}
+
+
+// Can the head move into a cell without crashing?  The snake's own tail
+// cell is safe, since the tail moves out of the way in the same tick.
+static bool isSafe(State* statep, Snake* snakep, int x, int y) {
+    if (isOccupied(statep, x, y) == false) {
+        return true;
+    }
+    SnakeNode* tailp = snakeTail(snakep);
+    return snakep->head != snakep->tail && tailp->x == x && tailp->y == y;
+}
+
+
+// Return the number of arena bytes autopilotInit() takes.  The grid
+// dimensions must be set.
+size_t autopilotBytes(State* statep) {
+    size_t count = (size_t)statep->gridWidth * statep->gridHeight;
+    return 2 * arenaRound(count * sizeof(Cell)) + arenaRound(count * sizeof(uint16_t));
+}
+
+
+// Allocate the autopilot for a game from an arena, which must have
+// autopilotBytes() to spare.  The grid dimensions must be set.
+void autopilotInit(Autopilot* autopilotp, State* statep, uint32_t budgetUs, Arena* arenap) {
+    size_t count = (size_t)statep->gridWidth * statep->gridHeight;
+    autopilotp->budgetUs = budgetUs;
+    autopilotp->distancep = arenaAlloc(arenap, count * sizeof(Cell));
+    autopilotp->stampp = arenaAlloc(arenap, count * sizeof(uint16_t));
+    autopilotp->stamp = 0;
+    autopilotp->queuep = arenaAlloc(arenap, count * sizeof(Cell));
+    autopilotp->worstNs = 0;
+    autopilotReset(autopilotp);
+}
+
+
+// Forget the distance field.  Call after restart().
+void autopilotReset(Autopilot* autopilotp) {
+    autopilotp->hasTarget = false;
+    autopilotp->searching = false;
+}
+
+
+// Return the distance from a cell to the food, as far as the current search
+// has got.
+static Cell distanceAt(Autopilot* autopilotp, size_t cell) {
+    if (autopilotp->stampp[cell] != autopilotp->stamp) {
+        return AUTOPILOT_UNREACHED;
+    }
+    return autopilotp->distancep[cell];
+}
+
+
+// Start a new search outwards from the food.  Stamping each cell with the
+// search it belongs to saves clearing the whole field every time.
+static void startSearch(Autopilot* autopilotp, State* statep) {
+    autopilotp->stamp++;
+    if (autopilotp->stamp == 0) {
+        // wrapped around: old stamps could look current.
+        size_t count = statep->gridWidth * statep->gridHeight;
+        memset(autopilotp->stampp, 0, count * sizeof(uint16_t));
+        autopilotp->stamp = 1;
+    }
+    Cell foodCell = statep->food.y * boardWidth(statep) + statep->food.x;
+    autopilotp->distancep[foodCell] = 0;
+    autopilotp->stampp[foodCell] = autopilotp->stamp;
+    autopilotp->queuep[0] = foodCell;
+    autopilotp->queueHead = 0;
+    autopilotp->queueTail = 1;
+    autopilotp->searching = true;
+    autopilotp->hasTarget = true;
+    autopilotp->target = statep->food;
+}
+
+
+// Carry on with the search until it is finished or the deadline passes.
+static void continueSearch(Autopilot* autopilotp, State* statep, uint64_t deadlineNs) {
+    Cell* distancep = autopilotp->distancep;
+    uint16_t* stampp = autopilotp->stampp;
+    uint16_t stamp = autopilotp->stamp;
+    Cell* queuep = autopilotp->queuep;
+    Coord gridWidth = boardWidth(statep);
+    int expanded = 0;
+    while (autopilotp->queueHead < autopilotp->queueTail) {
+        if (++expanded % CELLS_PER_CLOCK_CHECK == 0 && nowNs() >= deadlineNs) {
+            return;
+        }
+        Cell cell = queuep[autopilotp->queueHead++];
+        int x = cell % gridWidth;
+        int y = cell / gridWidth;
+        for (uint8_t direction = UP; direction <= LEFT; direction++) {
+            int nx;
+            int ny;
+            if (neighbour(statep, x, y, direction, &nx, &ny) == false) {
+                continue;
+            }
+            Cell next = ny * gridWidth + nx;
+            if (stampp[next] == stamp || isOccupied(statep, nx, ny)) {
+                continue;
+            }
+            stampp[next] = stamp;
+            distancep[next] = distancep[cell] + 1;
+            queuep[autopilotp->queueTail++] = next;
+        }
+    }
+    autopilotp->searching = false;
+}
+
+
+// Count the safe cells next to a cell, as a cheap measure of how much room
+// there is to move on from it.
+static int freedom(State* statep, Snake* snakep, int x, int y) {
+    int count = 0;
+    for (uint8_t direction = UP; direction <= LEFT; direction++) {
+        int nx;
+        int ny;
+        if (neighbour(statep, x, y, direction, &nx, &ny) && isSafe(statep, snakep, nx, ny)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+
+// Pick the direction for a snake's next move.  Call before moveSnake().
+void autopilotSteer(Autopilot* autopilotp, State* statep, Snake* snakep) {
+    uint64_t startNs = nowNs();
+    Food food = statep->food;
+    if (autopilotp->hasTarget == false || autopilotp->target.x != food.x || autopilotp->target.y != food.y) {
+        startSearch(autopilotp, statep);
+    }
+    if (autopilotp->searching) {
+        continueSearch(autopilotp, statep, startNs + autopilotp->budgetUs * 1000ULL);
+    }
+
+    SnakeNode* headp = snakeHead(snakep);
+    SnakeNode* tailp = snakeTail(snakep);
+    int x = headp->x;
+    int y = headp->y;
+    uint8_t bestDirection = 0;
+    Cell bestDistance = AUTOPILOT_UNREACHED;
+    uint8_t fallbackDirection = 0;
+    int fallbackScore = -1;
+    for (uint8_t direction = UP; direction <= LEFT; direction++) {
+        // the snake can't reverse.
+        int nx;
+        int ny;
+        if (direction == reverseDirection(snakep->direction) || neighbour(statep, x, y, direction, &nx, &ny) == false) {
+            continue;
+        }
+        if (isSafe(statep, snakep, nx, ny) == false) {
+            continue;
+        }
+        // head down the distance field if the search has got this far.
+        Cell distance = distanceAt(autopilotp, ny * boardWidth(statep) + nx);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            bestDirection = direction;
+        }
+        // otherwise chase the tail, or at least keep some room to move.
+        int score = freedom(statep, snakep, nx, ny);
+        if (tailp->x == nx && tailp->y == ny) {
+            score += 4;
+        }
+        if (score > fallbackScore) {
+            fallbackScore = score;
+            fallbackDirection = direction;
+        }
+    }
+    if (bestDirection != 0) {
+        turnSnake(snakep, bestDirection);
+    } else if (fallbackDirection != 0) {
+        turnSnake(snakep, fallbackDirection);
+    }
+
+    uint64_t elapsedNs = nowNs() - startNs;
+    if (elapsedNs > autopilotp->worstNs) {
+        autopilotp->worstNs = elapsedNs;
+    }
+}
@@ -0,0 +1,64 @@
+// The autopilot: steers the snake by itself, for attract mode and testing.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// The autopilot follows a distance field which is a breadth-first search
+// outwards from the food, walled in by the occupancy bitmap.  The field stays
+// usable for as long as the food stays put: the body only ever grows into
+// cells along the path being followed, and the cells freed by the tail can
+// only make the real distances shorter.  So the search runs once per food,
+// spread over as many ticks as needed to stay within the time budget, and
+// every tick in between just reads the field.  Until the search reaches the
+// head, or if the food can't be reached at all, the snake chases its tail.
+
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include "engine.h"
+
+#include <stdint.h>  // uint16_t
+#include <stdbool.h>  // bool
+#include <stddef.h>  // size_t
+
+#define AUTOPILOT_UNREACHED ((Cell)~0)
+
+
+// The autopilot state, including the search in progress.
+struct _Autopilot {
+    uint32_t budgetUs;  // the most time to spend searching per tick.
+
+    Cell* distancep;  // per cell, the number of moves to the food.
+    uint16_t* stampp;  // per cell, the search which set its distance.
+    uint16_t stamp;  // the current search.
+    Cell* queuep;  // the search frontier, as cell indices.
+    size_t queueHead;
+    size_t queueTail;
+    bool searching;  // the search is not finished yet.
+    bool hasTarget;
+    Food target;  // the food the distance field leads to.
+
+    uint64_t worstNs;  // the longest autopilotSteer() so far.
+};
+typedef struct _Autopilot Autopilot;
+
+
+// Return the number of arena bytes autopilotInit() takes.  The grid
+// dimensions must be set.
+size_t autopilotBytes(State* statep);
+
+// Allocate the autopilot for a game from an arena, which must have
+// autopilotBytes() to spare.  The grid dimensions must be set.
+void autopilotInit(Autopilot* autopilotp, State* statep, uint32_t budgetUs, Arena* arenap);
+
+// Forget the distance field.  Call after restart().
+void autopilotReset(Autopilot* autopilotp);
+
+// Pick the direction for a snake's next move.  Call before moveSnake().
+void autopilotSteer(Autopilot* autopilotp, State* statep, Snake* snakep);
+
+#endif
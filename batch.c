@@ -0,0 +1,331 @@
+// Batch simulator: runs many independent headless games across all cores.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// Every game is seeded from its index, so the results do not depend on the
+// number of threads or on which worker ran which game.
+
+#include "engine.h"
+
+#include <stdint.h>  // uint64_t
+#include <stdio.h>  // printf
+#include <stdlib.h>  // atoi, aligned_alloc, calloc
+#include <pthread.h>  // pthread_create, pthread_mutex_lock
+#include <time.h>  // clock_gettime
+#include <unistd.h>  // sysconf
+
+#define CACHE_LINE 64
+#define CHUNK_SIZE 16  // games a worker takes from its own queue at once.
+
+
+// The outcome of one game.
+struct _GameResult {
+    uint32_t length;
+    uint32_t ticks;
+    uint8_t cause;
+};
+typedef struct _GameResult GameResult;
+
+
+struct _Batch;
+
+
+// One worker thread.  Each worker sits in its own run of cache lines: the
+// queue bounds are only touched by the owner and the occasional thief, and
+// the game state is only touched by the owner.
+struct _Worker {
+    _Alignas(CACHE_LINE) pthread_mutex_t lock;
+    size_t next;  // the games still queued are [next, end), under lock.
+    size_t end;
+
+    _Alignas(CACHE_LINE) State state;
+    Arena arena;
+    uint32_t policyRng;
+    uint64_t steals;
+    struct _Batch* batchp;
+    pthread_t thread;
+    size_t index;
+};
+typedef struct _Worker Worker;
+
+
+// A batch of games, and the workers running them.
+struct _Batch {
+    Coord gridWidth;
+    Coord gridHeight;
+    uint8_t snakeCount;  // the snakes sharing each board.
+    uint32_t seed;
+    uint32_t maxTicks;  // games still alive after this many ticks time out.
+    size_t gameCount;
+    GameResult* resultsp;
+    size_t workerCount;
+    Worker* workersp;
+};
+typedef struct _Batch Batch;
+
+
+// Return the nanoseconds elapsed since an arbitrary point.
+uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Would moving one block in direction kill a snake right away?
+bool isDeadly(State* statep, Snake* snakep, uint8_t direction) {
+    int x = snakeHead(snakep)->x;
+    int y = snakeHead(snakep)->y;
+    if (direction == UP) {
+        y--;
+    } else if (direction == DOWN) {
+        y++;
+    } else if (direction == LEFT) {
+        x--;
+    } else {
+        x++;
+    }
+    if (x < 0 || y < 0 || x >= statep->gridWidth || y >= statep->gridHeight) {
+        return true;
+    }
+    return isOccupied(statep, x, y);
+}
+
+
+// The bot policy: head for the food, avoiding moves which die immediately,
+// and break ties at random.
+void steer(State* statep, Snake* snakep, uint32_t* rngp) {
+    uint8_t candidates[4];
+    int count = 0;
+    int bestDistance = 1 << 30;
+    for (uint8_t direction = UP; direction <= LEFT; direction++) {
+        // the snake can't reverse.
+        if (direction == reverseDirection(snakep->direction) || isDeadly(statep, snakep, direction)) {
+            continue;
+        }
+        int dx = snakeHead(snakep)->x - statep->food.x;
+        int dy = snakeHead(snakep)->y - statep->food.y;
+        dx += direction == RIGHT ? 1 : direction == LEFT ? -1 : 0;
+        dy += direction == DOWN ? 1 : direction == UP ? -1 : 0;
+        int distance = abs(dx) + abs(dy);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            count = 0;
+        }
+        if (distance == bestDistance) {
+            candidates[count++] = direction;
+        }
+    }
+    if (count > 0) {
+        turnSnake(snakep, candidates[xorshift32(rngp) % count]);
+    }
+}
+
+
+// Play one game to the end on the worker's state.
+void runGame(Worker* workerp, size_t game) {
+    Batch* batchp = workerp->batchp;
+    State* statep = &(workerp->state);
+    seedRandom(statep, batchp->seed + game);
+    workerp->policyRng = scrambleSeed(~(batchp->seed + game));
+    restart(statep);
+
+    uint32_t startTick = statep->tickCount;
+    while (statep->crashed == false && statep->tickCount - startTick < batchp->maxTicks) {
+        for (uint8_t i = 0; i < statep->snakeCount; i++) {
+            Snake* snakep = &(statep->snakesp[i]);
+            if (snakep->crashed == false) {
+                steer(statep, snakep, &(workerp->policyRng));
+            }
+        }
+        moveSnake(statep);
+    }
+
+    GameResult* resultp = &(batchp->resultsp[game]);
+    resultp->length = coveredCells(statep);
+    resultp->ticks = statep->tickCount - startTick;
+    resultp->cause = statep->crashCause;
+}
+
+
+// Take up to half of the games queued on another worker.  Returns false if
+// every other worker is out of games.
+bool steal(Worker* workerp, size_t* nextp, size_t* endp) {
+    Batch* batchp = workerp->batchp;
+    for (size_t i = 1; i < batchp->workerCount; i++) {
+        Worker* victimp = &(batchp->workersp[(workerp->index + i) % batchp->workerCount]);
+        pthread_mutex_lock(&(victimp->lock));
+        size_t remaining = victimp->end - victimp->next;
+        if (remaining > 0) {
+            *endp = victimp->end;
+            *nextp = victimp->end - (remaining + 1) / 2;
+            victimp->end = *nextp;
+        }
+        pthread_mutex_unlock(&(victimp->lock));
+        if (remaining > 0) {
+            workerp->steals++;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// The worker thread: play games from its own queue a chunk at a time, and
+// steal from the others once it runs dry.
+void* workerMain(void* argp) {
+    Worker* workerp = argp;
+    Batch* batchp = workerp->batchp;
+    // allocated here, so that the buffers are local to this thread.
+    workerp->state.gridWidth = batchp->gridWidth;
+    workerp->state.gridHeight = batchp->gridHeight;
+    workerp->state.snakeCount = batchp->snakeCount;
+    arenaInit(&(workerp->arena), gameBytes(&(workerp->state)));
+    initGame(&(workerp->state), &(workerp->arena));
+    arenaSeal(&(workerp->arena));
+
+    while (true) {
+        pthread_mutex_lock(&(workerp->lock));
+        size_t first = workerp->next;
+        size_t last = first + CHUNK_SIZE < workerp->end ? first + CHUNK_SIZE : workerp->end;
+        workerp->next = last;
+        pthread_mutex_unlock(&(workerp->lock));
+
+        if (first == last) {
+            size_t next;
+            size_t end;
+            if (steal(workerp, &next, &end) == false) {
+                break;
+            }
+            pthread_mutex_lock(&(workerp->lock));
+            workerp->next = next;
+            workerp->end = end;
+            pthread_mutex_unlock(&(workerp->lock));
+            continue;
+        }
+        for (size_t game = first; game < last; game++) {
+            runGame(workerp, game);
+        }
+    }
+    arenaFree(&(workerp->arena));
+    return NULL;
+}
+
+
+// Run every game of the batch on workerCount threads.  Returns the number
+// of steals.
+uint64_t runBatch(Batch* batchp, size_t workerCount) {
+    batchp->workerCount = workerCount;
+    batchp->workersp = aligned_alloc(CACHE_LINE, workerCount * sizeof(Worker));
+    assert(batchp->workersp != NULL);
+
+    // hand each worker a contiguous share of the games.
+    for (size_t i = 0; i < workerCount; i++) {
+        Worker* workerp = &(batchp->workersp[i]);
+        pthread_mutex_init(&(workerp->lock), NULL);
+        workerp->next = batchp->gameCount * i / workerCount;
+        workerp->end = batchp->gameCount * (i + 1) / workerCount;
+        workerp->steals = 0;
+        workerp->batchp = batchp;
+        workerp->index = i;
+    }
+    for (size_t i = 0; i < workerCount; i++) {
+        Worker* workerp = &(batchp->workersp[i]);
+        int ret = pthread_create(&(workerp->thread), NULL, workerMain, workerp);
+        assert(ret == 0);
+    }
+
+    for (size_t i = 0; i < workerCount; i++) {
+        pthread_join(batchp->workersp[i].thread, NULL);
+    }
+    // only once every worker is done: the others may still try to steal.
+    uint64_t steals = 0;
+    for (size_t i = 0; i < workerCount; i++) {
+        Worker* workerp = &(batchp->workersp[i]);
+        pthread_mutex_destroy(&(workerp->lock));
+        steals += workerp->steals;
+    }
+    free(batchp->workersp);
+    return steals;
+}
+
+
+// Print the aggregate results of a finished batch.
+void printSummary(Batch* batchp) {
+    uint64_t totalLength = 0;
+    uint64_t totalTicks = 0;
+    uint32_t bestLength = 0;
+    size_t causes[4] = {0};
+    size_t timeouts = 0;
+    for (size_t i = 0; i < batchp->gameCount; i++) {
+        GameResult* resultp = &(batchp->resultsp[i]);
+        totalLength += resultp->length;
+        totalTicks += resultp->ticks;
+        if (resultp->length > bestLength) {
+            bestLength = resultp->length;
+        }
+        if (resultp->cause == CRASH_NONE) {
+            timeouts++;
+        } else {
+            causes[resultp->cause]++;
+        }
+    }
+    printf("games: %zu, %u snakes each\n", batchp->gameCount, batchp->snakeCount);
+    printf("mean length: %.2f (best %u)\n", (double)totalLength / batchp->gameCount, bestLength);
+    printf("mean ticks: %.1f\n", (double)totalTicks / batchp->gameCount);
+    printf("deaths: wall %zu, self %zu, board full %zu, timeout %zu\n",
+        causes[CRASH_WALL], causes[CRASH_SELF], causes[CRASH_FULL], timeouts);
+}
+
+
+// The batch entry point: run the same batch with 1, 2, 4, ... threads up to
+// maxThreads, and report games per second and the speedup over one thread.
+// usage: snake-batch [games [maxThreads [gridWidth gridHeight [snakes]]]]
+int main(int argc, char** argv) {
+    // checked as ints, before they go into narrower or unsigned fields.
+    int gameCount = argc > 1 ? atoi(argv[1]) : 10000;
+    int threadCount = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int width = argc > 4 ? atoi(argv[3]) : 15;
+    int height = argc > 4 ? atoi(argv[4]) : 10;
+    int snakeCount = argc > 5 ? atoi(argv[5]) : 1;
+    assert(gameCount > 0 && threadCount > 0);
+    assert(width > 0 && width <= MAX_GRID_SIDE && height > 0 && height <= MAX_GRID_SIDE);
+    assert(snakeCount > 0 && snakeCount <= MAX_SNAKES);
+
+    Batch batch;
+    batch.gridWidth = width;
+    batch.gridHeight = height;
+    batch.snakeCount = snakeCount;
+    batch.seed = 1;
+    batch.maxTicks = 100 * (uint32_t)batch.gridWidth * batch.gridHeight;
+    batch.gameCount = gameCount;
+    size_t maxThreads = threadCount;
+    batch.resultsp = calloc(batch.gameCount, sizeof(GameResult));
+    assert(batch.resultsp != NULL);
+
+    printf("threads,games_per_second,speedup,steals\n");
+    double baseline = 0;
+    size_t threads = 1;
+    while (true) {
+        uint64_t startNs = nowNs();
+        uint64_t steals = runBatch(&batch, threads);
+        uint64_t endNs = nowNs();
+        double gamesPerSecond = batch.gameCount * 1e9 / (endNs - startNs);
+        if (threads == 1) {
+            baseline = gamesPerSecond;
+        }
+        printf("%zu,%.0f,%.2f,%llu\n", threads, gamesPerSecond, gamesPerSecond / baseline,
+            (unsigned long long)steals);
+        if (threads == maxThreads) {
+            break;
+        }
+        threads = threads * 2 < maxThreads ? threads * 2 : maxThreads;
+    }
+    printSummary(&batch);
+    return 0;
+}
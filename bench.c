@@ -0,0 +1,284 @@
+// Headless benchmarks for the snake engine.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "engine.h"
+#include "cycle.h"
+
+#include <stdint.h>  // uint64_t
+#include <stdio.h>  // printf
+#include <stdlib.h>  // atoi, malloc
+#include <string.h>  // strcmp
+#include <time.h>  // clock_gettime
+
+
+// Return the nanoseconds elapsed since an arbitrary point.
+uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// The ring buffer as it was before the typed ring: untyped slots, with an
+// overflow check and a compare-and-wrap on every step.  Kept here only as the
+// baseline for benchRing().
+struct _RefRing {
+    void* firstp;
+    void* lastp;
+    size_t unitSize;
+};
+typedef struct _RefRing RefRing;
+
+
+// Return the next slot in the baseline ring.  Not inlined, as the original
+// was called across translation units.
+__attribute__((noinline)) void* refRingNext(RefRing* ringp, void* currentp) {
+    void* nextp = ((uint8_t*)currentp) + ringp->unitSize;
+    assert(nextp > currentp);  // check for overflow.
+    if (nextp > ringp->lastp) {
+        nextp = ringp->firstp;
+    }
+    return nextp;
+}
+
+
+// Iterate the baseline ring to the next block of the snake body, or NULL.
+__attribute__((noinline)) SnakeNode* refSnakeNext(RefRing* ringp, SnakeNode* tailp, SnakeNode* snakep) {
+    if (snakep == tailp) {
+        return NULL;
+    }
+    return refRingNext(ringp, snakep);
+}
+
+
+// The board sides tried by benchScaling(), as far as MAX_GRID_SIDE allows.
+static const int scalingSides[] = {16, 64, 128, 256, 1024, 4096};
+#define SCALING_SIDE_COUNT (sizeof(scalingSides) / sizeof(scalingSides[0]))
+#define SCALING_TICKS (1 << 20)  // ticks timed per board and length.
+#define SCALING_RESPAWNS (1 << 20)
+
+// The numbers of snakes tried by benchSnakes(), on one 128x128 board.
+static const int snakeCounts[] = {1, 4, 16, 64, 255};
+#define SNAKE_COUNT_COUNT (sizeof(snakeCounts) / sizeof(snakeCounts[0]))
+
+
+// Grow the snake along a cycle until it covers 99% of the board, and report
+// the cost per tick against the snake length.  Returns the ticks simulated.
+uint64_t benchGrowth(State* statep) {
+    size_t cellCount = (size_t)statep->gridWidth * statep->gridHeight;
+    size_t bucketSize = cellCount / 10;
+    size_t length = 1;
+    size_t ticks = 0;
+    uint64_t totalTicks = 0;
+    restart(statep);
+    Snake* snakep = playerSnake(statep);
+
+    uint64_t startNs = nowNs();
+    printf("length,ticks,ns_per_tick\n");
+    while (length < cellCount * 99 / 100) {
+        snakep->direction = cycleDirection(statep, snakeHead(snakep)->x, snakeHead(snakep)->y);
+        uint32_t tail = snakep->tail;
+        moveSnake(statep);
+        assert(statep->crashed == false);
+        ticks++;
+        if (snakep->tail == tail) {
+            length++;
+            if (length % bucketSize == 0) {
+                uint64_t endNs = nowNs();
+                printf("%zu,%zu,%.1f\n", length, ticks, (double)(endNs - startNs) / ticks);
+                totalTicks += ticks;
+                ticks = 0;
+                startNs = nowNs();
+            }
+        }
+    }
+    return totalTicks + ticks;
+}
+
+
+// Walk the whole body of the grown snake many times, once through a copy of
+// it in the baseline ring and once by following the packed links, and report
+// the cost and the memory per block of each.
+void benchRing(State* statep) {
+    Snake* snakep = playerSnake(statep);
+    Ring* ringp = &(snakep->ring);
+    uint32_t length = snakeLength(snakep);
+    size_t capacity = ringp->mask + 1;
+
+    // lay the positions out in the baseline ring, head first.
+    SnakeNode* nodesp = malloc(capacity * sizeof(SnakeNode));
+    assert(nodesp != NULL);
+    RefRing ref = {nodesp, nodesp + capacity - 1, sizeof(SnakeNode)};
+    SnakeNode block = *snakeHead(snakep);
+    uint32_t i = snakep->head;
+    for (uint32_t n = 0; n < length; n++) {
+        nodesp[n] = block;
+        stepNode(&block, ringLink(ringp, i));
+        i = ringNext(ringp, i);
+    }
+
+    int rounds = 20000000 / length + 1;
+    uint64_t blocks = (uint64_t)rounds * length;
+    // the sums keep the walks from being optimized away.
+    uint32_t refSum = 0;
+    uint32_t sum = 0;
+
+    uint64_t startNs = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        SnakeNode* nodep = nodesp;
+        SnakeNode* tailp = nodesp + length - 1;
+        while (nodep != NULL) {
+            refSum += nodep->x + nodep->y;
+            nodep = refSnakeNext(&ref, tailp, nodep);
+        }
+    }
+    uint64_t refNs = nowNs() - startNs;
+
+    startNs = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        block = *snakeHead(snakep);
+        i = snakep->head;
+        for (uint32_t n = length; n > 0; n--) {
+            sum += block.x + block.y;
+            stepNode(&block, ringLink(ringp, i));
+            i = ringNext(ringp, i);
+        }
+    }
+    uint64_t ringNs = nowNs() - startNs;
+    assert(sum == refSum);
+    free(nodesp);
+
+    printf("ring,length,ns_per_block,bits_per_block\n");
+    printf("void*,%u,%.3f,%zu\n", length, (double)refNs / blocks, sizeof(SnakeNode) * 8);
+    printf("links,%u,%.3f,2\n", length, (double)ringNs / blocks);
+}
+
+
+// Measure the cost of a tick and of putting down food, and the memory used,
+// on square boards of growing area with snakes of growing length.  None of
+// them should grow with the length of the snake.
+void benchScaling(void) {
+    printf("side,cells,length,state_bytes,ns_per_tick,ns_per_respawn\n");
+    for (size_t i = 0; i < SCALING_SIDE_COUNT && scalingSides[i] <= MAX_GRID_SIDE; i++) {
+        State state;
+        state.gridWidth = scalingSides[i];
+        state.gridHeight = scalingSides[i];
+        state.snakeCount = 1;
+        Arena arena;
+        arenaInit(&arena, gameBytes(&state));
+        initGame(&state, &arena);
+        seedRandom(&state, 1);
+        Cell cellCount = (Cell)state.gridWidth * state.gridHeight;
+        Cell lengths[] = {1, cellCount / 10, cellCount / 2, cellCount * 9 / 10};
+        for (int j = 0; j < 4; j++) {
+            layOnCycle(&state, lengths[j]);
+            uint64_t tickNs = 0;
+            uint64_t startNs = nowNs();
+            for (int tick = 0; tick < SCALING_TICKS; tick++) {
+                steerOnCycle(&state);
+                moveSnake(&state);
+                if (state.crashed) {
+                    // a small board fills up: start again, off the clock.
+                    assert(state.crashCause == CRASH_FULL);
+                    tickNs += nowNs() - startNs;
+                    layOnCycle(&state, lengths[j]);
+                    startNs = nowNs();
+                }
+            }
+            tickNs += nowNs() - startNs;
+
+            startNs = nowNs();
+            for (int respawn = 0; respawn < SCALING_RESPAWNS; respawn++) {
+                respawnFood(&state);
+            }
+            uint64_t respawnNs = nowNs() - startNs;
+
+            printf("%u,%u,%u,%zu,%.1f,%.1f\n", (unsigned)state.gridWidth, (unsigned)cellCount,
+                (unsigned)lengths[j], gameBytes(&state),
+                (double)tickNs / SCALING_TICKS, (double)respawnNs / SCALING_RESPAWNS);
+        }
+        arenaFree(&arena);
+    }
+}
+
+
+// Measure the cost of a tick with more and more snakes sharing one board,
+// which together always cover half of it.  The cost should grow with the
+// number of snakes, and not with how long they are.
+void benchSnakes(void) {
+    printf("snakes,length,ns_per_tick,ns_per_snake_move\n");
+    for (size_t i = 0; i < SNAKE_COUNT_COUNT; i++) {
+        State state;
+        state.gridWidth = 128;
+        state.gridHeight = 128;
+        state.snakeCount = snakeCounts[i];
+        Arena arena;
+        arenaInit(&arena, gameBytes(&state));
+        initGame(&state, &arena);
+        seedRandom(&state, 1);
+        Cell length = (Cell)state.gridWidth * state.gridHeight / state.snakeCount / 2;
+        layOnCycle(&state, length);
+        uint64_t tickNs = 0;
+        uint64_t startNs = nowNs();
+        for (int tick = 0; tick < SCALING_TICKS; tick++) {
+            steerOnCycle(&state);
+            moveSnake(&state);
+            if (state.aliveCount < state.snakeCount || state.crashed) {
+                // a snake which grew caught up with the one in front: start
+                // again, off the clock.
+                tickNs += nowNs() - startNs;
+                layOnCycle(&state, length);
+                startNs = nowNs();
+            }
+        }
+        tickNs += nowNs() - startNs;
+        printf("%u,%u,%.1f,%.2f\n", (unsigned)state.snakeCount, (unsigned)length,
+            (double)tickNs / SCALING_TICKS, (double)tickNs / SCALING_TICKS / state.snakeCount);
+        arenaFree(&arena);
+    }
+}
+
+
+// The benchmark entry point.
+// usage: snake-bench [gridWidth gridHeight]
+//        snake-bench --scaling
+//        snake-bench --snakes
+int main(int argc, char** argv) {
+    if (argc == 2 && strcmp(argv[1], "--scaling") == 0) {
+        benchScaling();
+        return 0;
+    }
+    if (argc == 2 && strcmp(argv[1], "--snakes") == 0) {
+        benchSnakes();
+        return 0;
+    }
+    State state;
+    state.gridWidth = 64;
+    state.gridHeight = 64;
+    state.snakeCount = 1;
+    if (argc == 3) {
+        int width = atoi(argv[1]);
+        int height = atoi(argv[2]);
+        assert(width <= MAX_GRID_SIDE && height <= MAX_GRID_SIDE);
+        state.gridWidth = width;
+        state.gridHeight = height;
+    }
+    assert(state.gridWidth >= 2 && state.gridHeight % 2 == 0);
+    Arena arena;
+    arenaInit(&arena, gameBytes(&state));
+    initGame(&state, &arena);
+    seedRandom(&state, 1);
+
+    uint64_t startNs = nowNs();
+    uint64_t ticks = benchGrowth(&state);
+    uint64_t endNs = nowNs();
+    printf("ticks_per_second,%.0f\n", ticks * 1e9 / (endNs - startNs));
+    benchRing(&state);
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Steering snakes around a fixed cycle of the board, for the benchmarks.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "cycle.h"
+
+#include <assert.h>  // assert
+
+
+// The way along a fixed Hamiltonian cycle of the grid from a cell, so that
+// the snake can grow to fill the board without crashing.  Requires an even
+// gridHeight.
+uint8_t cycleDirection(State* statep, Coord x, Coord y) {
+    Coord lastX = statep->gridWidth - 1;
+    Coord lastY = statep->gridHeight - 1;
+    if (x == 0) {
+        return y == 0 ? RIGHT : UP;
+    } else if (y % 2 == 0) {
+        return x < lastX ? RIGHT : DOWN;
+    } else if (x > 1) {
+        return LEFT;
+    } else {
+        return y == lastY ? LEFT : DOWN;
+    }
+}
+
+
+// Lay every snake along the cycle, each length blocks long, spaced evenly
+// from the top left corner, and put down food for them.
+void layOnCycle(State* statep, Cell length) {
+    Cell gap = (Cell)statep->gridWidth * statep->gridHeight / statep->snakeCount;
+    assert(length <= gap);
+    Cell lengths[MAX_SNAKES];
+    SnakeNode block = {0, 0};
+    Cell position = 0;
+    for (uint8_t i = 0; i < statep->snakeCount; i++) {
+        Snake* snakep = &(statep->snakesp[i]);
+        // walk from the tail to the head, linking each block back to the
+        // last, and on to the next snake's tail.
+        for (; position < i * gap + length - 1; position++) {
+            uint8_t direction = cycleDirection(statep, block.x, block.y);
+            Cell step = position - i * gap;
+            if (step + 1 < length) {
+                ringSetLink(&(snakep->ring), length - 2 - step, reverseDirection(direction));
+            }
+            stepNode(&block, direction);
+        }
+        snakep->headNode = block;
+        snakep->direction = cycleDirection(statep, block.x, block.y);
+        lengths[i] = length;
+        for (; position < (i + 1) * gap && i + 1 < statep->snakeCount; position++) {
+            stepNode(&block, cycleDirection(statep, block.x, block.y));
+        }
+    }
+    bool ok = placeSnakes(statep, lengths);
+    assert(ok);
+    ok = respawnFood(statep);
+    assert(ok);
+}
+
+
+// Point every live snake on along the cycle.
+void steerOnCycle(State* statep) {
+    for (uint8_t i = 0; i < statep->snakeCount; i++) {
+        Snake* snakep = &(statep->snakesp[i]);
+        SnakeNode* headp = snakeHead(snakep);
+        snakep->direction = cycleDirection(statep, headp->x, headp->y);
+    }
+}
@@ -0,0 +1,35 @@
+// Steering snakes around a fixed cycle of the board, for the benchmarks.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// The cycle snakes down the board from the top left corner, two rows at a
+// time, and back up the first column.  A snake which follows it never
+// crashes until the board is full, so a benchmark can hold a snake at any
+// length it likes.
+
+#ifndef CYCLE_H
+#define CYCLE_H
+
+#include "engine.h"
+
+#include <stdint.h>  // uint8_t
+
+
+// The way along a fixed Hamiltonian cycle of the grid from a cell, so that
+// the snake can grow to fill the board without crashing.  Requires an even
+// gridHeight.
+uint8_t cycleDirection(State* statep, Coord x, Coord y);
+
+// Lay every snake along the cycle, each length blocks long, spaced evenly
+// from the top left corner, and put down food for them.
+void layOnCycle(State* statep, Cell length);
+
+// Point every live snake on along the cycle.
+void steerOnCycle(State* statep);
+
+#endif
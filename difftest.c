@@ -0,0 +1,728 @@
+// Differential test: checks the engine against a plain reference model of
+// the rules, on many random seeded input streams.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// The reference keeps every snake as an array of block positions, head
+// first, and finds everything by walking it: how the game worked before the
+// occupancy bitmap, the free cell set, the packed links and the masked ring.
+// The free cells are kept in the same order as the engine keeps them (the
+// last free cell moves into the slot of a cell which is taken, and a cell
+// which comes free goes on the end), found by a linear search, because that
+// order decides where the food goes for a seed.
+//
+// Every stream gets its own board, number of snakes, steering policy and
+// seed, all drawn from the stream index, so a run doesn't depend on the
+// number of threads and any stream can be run again on its own.  After
+// every restart and every move the heads, tails, lengths, crashes and food
+// of the two must agree.  A stream which disagrees is cut short at the
+// first mismatch, and its turns are pared down for as long as it still
+// fails, to leave the smallest replay which shows the problem.
+
+#include "engine.h"
+#include "cycle.h"
+#include "replay.h"
+
+#include <stdint.h>  // uint64_t
+#include <stdio.h>  // printf, snprintf
+#include <stdlib.h>  // strtoul, malloc, abs
+#include <string.h>  // memmove, memcpy
+#include <pthread.h>  // pthread_create, pthread_mutex_lock
+#include <time.h>  // clock_gettime
+#include <unistd.h>  // sysconf
+
+#define MAX_DIFF_SNAKES 4
+#define MAX_DIFF_WIDTH 16
+#define MAX_DIFF_HEIGHT 12
+#define CHUNK_SIZE 256  // streams a worker takes at once.
+#define NO_MISMATCH 0xFFFFFFFF
+#define MAX_WHAT 128
+
+// How a stream steers its snakes.
+#define POLICY_RANDOM 0  // turn at random now and then.
+#define POLICY_GREEDY 1  // head for the food, unless that is deadly.
+#define POLICY_CYCLE 2  // follow the benchmark cycle, to fill the board.
+#define POLICY_COUNT 3
+
+
+// One snake, as the reference sees it.
+struct _RefSnake {
+    SnakeNode* blocksp;  // head first.
+    size_t length;
+    uint8_t direction;
+    bool crashed;  // it stays where it was, and keeps all of its cells.
+};
+typedef struct _RefSnake RefSnake;
+
+
+// The reference game.
+struct _RefGame {
+    Coord gridWidth;
+    Coord gridHeight;
+    uint8_t snakeCount;
+    uint8_t aliveCount;
+    RefSnake snakes[MAX_DIFF_SNAKES];
+    Cell* freep;
+    size_t freeCount;
+    Food food;
+    uint32_t rng;
+    bool crashed;
+    uint8_t crashCause;
+    uint32_t tickCount;
+};
+typedef struct _RefGame RefGame;
+
+
+// One turn of an input stream.
+struct _Turn {
+    uint32_t tick;  // applied just before the move of this tick.
+    uint8_t snake;
+    uint8_t direction;
+    bool accepted;  // by either game, the last time the stream was run.
+};
+typedef struct _Turn Turn;
+
+
+// Everything which makes up one input stream, apart from its turns.
+struct _Stream {
+    size_t index;
+    Coord gridWidth;
+    Coord gridHeight;
+    uint8_t snakeCount;
+    uint8_t policy;
+    uint32_t seed;  // of the game.
+    uint32_t inputSeed;  // of the steering.
+    uint32_t ticks;
+};
+typedef struct _Stream Stream;
+
+
+// The two games a stream runs on, and the log of its turns.
+struct _Checker {
+    State state;
+    Arena arena;  // big enough for any stream, and reset for each.
+    RefGame ref;
+    Turn* turnsp;
+    size_t turnCount;
+    uint32_t inputRng;
+    char what[MAX_WHAT];  // the first mismatch found.
+};
+typedef struct _Checker Checker;
+
+
+struct _Run;
+
+
+// One worker thread.
+struct _Worker {
+    struct _Run* runp;
+    Checker checker;
+    uint64_t ticks;
+    pthread_t thread;
+};
+typedef struct _Worker Worker;
+
+
+// A whole run: the streams still to check, and the first one to fail.
+struct _Run {
+    size_t streamCount;
+    uint32_t ticksPerStream;
+    uint32_t firstSeed;
+    pthread_mutex_t lock;
+    size_t next;  // under lock.
+    size_t failedStream;  // the lowest failing stream, or streamCount.
+};
+typedef struct _Run Run;
+
+
+// Return the nanoseconds elapsed since an arbitrary point.
+uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Allocate the reference game for a board.
+void refInit(RefGame* refp, Coord gridWidth, Coord gridHeight, uint8_t snakeCount) {
+    size_t count = (size_t)gridWidth * gridHeight;
+    refp->gridWidth = gridWidth;
+    refp->gridHeight = gridHeight;
+    refp->snakeCount = snakeCount;
+    for (uint8_t i = 0; i < snakeCount; i++) {
+        // one more, for a head on top.
+        refp->snakes[i].blocksp = malloc((count + 1) * sizeof(SnakeNode));
+        assert(refp->snakes[i].blocksp != NULL);
+    }
+    refp->freep = malloc(count * sizeof(Cell));
+    assert(refp->freep != NULL);
+    refp->tickCount = 0;
+}
+
+
+// Free the reference game.
+void refFree(RefGame* refp) {
+    for (uint8_t i = 0; i < refp->snakeCount; i++) {
+        free(refp->snakes[i].blocksp);
+    }
+    free(refp->freep);
+}
+
+
+// Return the next number from the reference game's generator.
+uint32_t refRandom(RefGame* refp) {
+    return xorshift32(&(refp->rng));
+}
+
+
+// Is a cell covered by any snake?
+bool refOccupied(RefGame* refp, int x, int y) {
+    for (uint8_t i = 0; i < refp->snakeCount; i++) {
+        RefSnake* snakep = &(refp->snakes[i]);
+        for (size_t j = 0; j < snakep->length; j++) {
+            if (snakep->blocksp[j].x == x && snakep->blocksp[j].y == y) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+// Take a cell out of the free list.
+void refTake(RefGame* refp, int x, int y) {
+    Cell cell = y * refp->gridWidth + x;
+    for (size_t k = 0; k < refp->freeCount; k++) {
+        if (refp->freep[k] == cell) {
+            refp->freeCount--;
+            refp->freep[k] = refp->freep[refp->freeCount];
+            return;
+        }
+    }
+    assert(false);
+}
+
+
+// Put a cell back on the end of the free list.
+void refGive(RefGame* refp, int x, int y) {
+    refp->freep[refp->freeCount++] = y * refp->gridWidth + x;
+}
+
+
+// Put the food on a random free cell.  Returns false if there are none.
+bool refRespawn(RefGame* refp) {
+    if (refp->freeCount == 0) {
+        return false;
+    }
+    Cell cell = refp->freep[refRandom(refp) % refp->freeCount];
+    refp->food.x = cell % refp->gridWidth;
+    refp->food.y = cell / refp->gridWidth;
+    return true;
+}
+
+
+// Start a new game.
+void refRestart(RefGame* refp) {
+    refp->freeCount = (size_t)refp->gridWidth * refp->gridHeight;
+    for (size_t k = 0; k < refp->freeCount; k++) {
+        refp->freep[k] = k;
+    }
+    for (uint8_t i = 0; i < refp->snakeCount; i++) {
+        RefSnake* snakep = &(refp->snakes[i]);
+        SnakeNode* headp = &(snakep->blocksp[0]);
+        if (i == 0) {
+            headp->x = refRandom(refp) % refp->gridWidth;
+            headp->y = refRandom(refp) % refp->gridHeight;
+        } else {
+            Cell cell = refp->freep[refRandom(refp) % refp->freeCount];
+            headp->x = cell % refp->gridWidth;
+            headp->y = cell / refp->gridWidth;
+        }
+        refTake(refp, headp->x, headp->y);
+        snakep->length = 1;
+        snakep->crashed = false;
+        snakep->direction = headp->x > refp->gridWidth / 2 ? LEFT : RIGHT;
+    }
+    refp->aliveCount = refp->snakeCount;
+    refRespawn(refp);
+    refp->crashed = false;
+    refp->crashCause = CRASH_NONE;
+}
+
+
+// Turn a snake, unless that reverses it.  Returns true if it turned.
+bool refTurn(RefSnake* snakep, uint8_t direction) {
+    if (direction == reverseDirection(snakep->direction)) {
+        return false;
+    }
+    snakep->direction = direction;
+    return true;
+}
+
+
+// Mark a snake as crashed.
+void refCrash(RefGame* refp, RefSnake* snakep, uint8_t cause) {
+    snakep->crashed = true;
+    refp->aliveCount--;
+    if (refp->aliveCount == 0) {
+        refp->crashed = true;
+        refp->crashCause = cause;
+    }
+}
+
+
+// Move every live snake one block, in order.
+void refMove(RefGame* refp) {
+    if (refp->crashed) {
+        return;
+    }
+    refp->tickCount++;
+    for (uint8_t i = 0; i < refp->snakeCount && refp->crashed == false; i++) {
+        RefSnake* snakep = &(refp->snakes[i]);
+        if (snakep->crashed) {
+            continue;
+        }
+        int x = snakep->blocksp[0].x;
+        int y = snakep->blocksp[0].y;
+        uint8_t direction = snakep->direction;
+        x += direction == RIGHT ? 1 : direction == LEFT ? -1 : 0;
+        y += direction == DOWN ? 1 : direction == UP ? -1 : 0;
+        if (x < 0 || y < 0 || x >= refp->gridWidth || y >= refp->gridHeight) {
+            refCrash(refp, snakep, CRASH_WALL);
+            continue;
+        }
+
+        // the tail moves out of the way before the head moves in, unless
+        // the snake grows.
+        bool didEat = x == refp->food.x && y == refp->food.y;
+        SnakeNode* tailp = &(snakep->blocksp[snakep->length - 1]);
+        bool intoTail = didEat == false && x == tailp->x && y == tailp->y;
+        if (refOccupied(refp, x, y) && intoTail == false) {
+            refCrash(refp, snakep, CRASH_SELF);
+            continue;
+        }
+        if (didEat == false) {
+            snakep->length--;
+            refGive(refp, tailp->x, tailp->y);
+        }
+        memmove(snakep->blocksp + 1, snakep->blocksp, snakep->length * sizeof(SnakeNode));
+        snakep->blocksp[0].x = x;
+        snakep->blocksp[0].y = y;
+        snakep->length++;
+        refTake(refp, x, y);
+        if (didEat && refRespawn(refp) == false) {
+            refp->crashed = true;
+            refp->crashCause = CRASH_FULL;
+        }
+    }
+}
+
+
+// Describe the first difference between the engine and the reference into
+// whatp.  Returns false if there is none.
+bool findMismatch(State* statep, RefGame* refp, char* whatp) {
+    if (statep->tickCount != refp->tickCount) {
+        snprintf(whatp, MAX_WHAT, "tick: engine %u, reference %u", statep->tickCount, refp->tickCount);
+        return true;
+    }
+    if (statep->crashed != refp->crashed || statep->crashCause != refp->crashCause) {
+        snprintf(whatp, MAX_WHAT, "game crash: engine %d cause %u, reference %d cause %u",
+            statep->crashed, statep->crashCause, refp->crashed, refp->crashCause);
+        return true;
+    }
+    if (statep->food.x != refp->food.x || statep->food.y != refp->food.y) {
+        snprintf(whatp, MAX_WHAT, "food: engine %u,%u, reference %u,%u",
+            statep->food.x, statep->food.y, refp->food.x, refp->food.y);
+        return true;
+    }
+    if (statep->freeCount != refp->freeCount) {
+        snprintf(whatp, MAX_WHAT, "free cells: engine %u, reference %zu", (unsigned)statep->freeCount, refp->freeCount);
+        return true;
+    }
+    for (uint8_t i = 0; i < statep->snakeCount; i++) {
+        Snake* snakep = &(statep->snakesp[i]);
+        RefSnake* refSnakep = &(refp->snakes[i]);
+        SnakeNode* headp = snakeHead(snakep);
+        SnakeNode* tailp = snakeTail(snakep);
+        SnakeNode* refHeadp = &(refSnakep->blocksp[0]);
+        SnakeNode* refTailp = &(refSnakep->blocksp[refSnakep->length - 1]);
+        if (snakep->crashed != refSnakep->crashed) {
+            snprintf(whatp, MAX_WHAT, "snake %u crashed: engine %d, reference %d", i, snakep->crashed, refSnakep->crashed);
+        } else if (snakeLength(snakep) != refSnakep->length) {
+            snprintf(whatp, MAX_WHAT, "snake %u length: engine %u, reference %zu", i, snakeLength(snakep), refSnakep->length);
+        } else if (headp->x != refHeadp->x || headp->y != refHeadp->y) {
+            snprintf(whatp, MAX_WHAT, "snake %u head: engine %u,%u, reference %u,%u",
+                i, headp->x, headp->y, refHeadp->x, refHeadp->y);
+        } else if (tailp->x != refTailp->x || tailp->y != refTailp->y) {
+            snprintf(whatp, MAX_WHAT, "snake %u tail: engine %u,%u, reference %u,%u",
+                i, tailp->x, tailp->y, refTailp->x, refTailp->y);
+        } else {
+            continue;
+        }
+        return true;
+    }
+    // a crashed snake is still in the way: every one of its cells must stay
+    // occupied, for the food and the other snakes.
+    for (uint8_t i = 0; i < statep->snakeCount; i++) {
+        RefSnake* refSnakep = &(refp->snakes[i]);
+        for (size_t j = 0; refSnakep->crashed && j < refSnakep->length; j++) {
+            SnakeNode* blockp = &(refSnakep->blocksp[j]);
+            if (isOccupied(statep, blockp->x, blockp->y) == false) {
+                snprintf(whatp, MAX_WHAT, "snake %u crashed, but its cell %u,%u is free in the engine",
+                    i, blockp->x, blockp->y);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+// Would moving one block in direction kill a snake right away, as far as
+// the reference can tell?
+bool refIsDeadly(RefGame* refp, RefSnake* snakep, uint8_t direction) {
+    int x = snakep->blocksp[0].x;
+    int y = snakep->blocksp[0].y;
+    x += direction == RIGHT ? 1 : direction == LEFT ? -1 : 0;
+    y += direction == DOWN ? 1 : direction == UP ? -1 : 0;
+    if (x < 0 || y < 0 || x >= refp->gridWidth || y >= refp->gridHeight) {
+        return true;
+    }
+    return refOccupied(refp, x, y);
+}
+
+
+// Pick the next turn for a live snake, or 0 to carry straight on.
+uint8_t pickTurn(Checker* checkerp, Stream* streamp, uint8_t i) {
+    RefGame* refp = &(checkerp->ref);
+    RefSnake* snakep = &(refp->snakes[i]);
+    uint32_t* rngp = &(checkerp->inputRng);
+    uint32_t roll = xorshift32(rngp);
+    // every policy turns at random now and then, to reach odd corners.
+    if (streamp->policy == POLICY_RANDOM || roll % 32 == 0) {
+        return roll % 4 == 1 ? xorshift32(rngp) % 4 + 1 : 0;
+    }
+    if (streamp->policy == POLICY_CYCLE && streamp->gridWidth >= 2 && streamp->gridHeight % 2 == 0) {
+        return cycleDirection(&(checkerp->state), snakep->blocksp[0].x, snakep->blocksp[0].y);
+    }
+    uint8_t best = 0;
+    int bestDistance = 1 << 30;
+    for (uint8_t direction = UP; direction <= LEFT; direction++) {
+        if (direction == reverseDirection(snakep->direction) || refIsDeadly(refp, snakep, direction)) {
+            continue;
+        }
+        int dx = snakep->blocksp[0].x - refp->food.x;
+        int dy = snakep->blocksp[0].y - refp->food.y;
+        dx += direction == RIGHT ? 1 : direction == LEFT ? -1 : 0;
+        dy += direction == DOWN ? 1 : direction == UP ? -1 : 0;
+        int distance = abs(dx) + abs(dy);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = direction;
+        }
+    }
+    return best;
+}
+
+
+// Draw the board, snakes, policy and seeds of a stream from its index.
+void streamInit(Stream* streamp, size_t index, uint32_t firstSeed, uint32_t ticks) {
+    uint32_t rng = scrambleSeed(firstSeed + index);
+    streamp->index = index;
+    streamp->gridWidth = 1 + xorshift32(&rng) % MAX_DIFF_WIDTH;
+    streamp->gridHeight = 1 + xorshift32(&rng) % MAX_DIFF_HEIGHT;
+    if (xorshift32(&rng) % 4 == 0) {
+        // the device board, as it is played.
+        streamp->gridWidth = 15;
+        streamp->gridHeight = 10;
+    }
+    size_t cellCount = (size_t)streamp->gridWidth * streamp->gridHeight;
+    streamp->snakeCount = 1;
+    if (xorshift32(&rng) % 4 == 0) {
+        streamp->snakeCount = 2 + xorshift32(&rng) % (MAX_DIFF_SNAKES - 1);
+    }
+    // leave room for the food.
+    while (streamp->snakeCount > 1 && cellCount < 2u * streamp->snakeCount) {
+        streamp->snakeCount--;
+    }
+    if (cellCount < 2) {
+        streamp->gridWidth = 2;
+    }
+    streamp->policy = xorshift32(&rng) % POLICY_COUNT;
+    streamp->seed = firstSeed + index;
+    streamp->inputSeed = xorshift32(&rng);
+    streamp->ticks = ticks;
+}
+
+
+// Run a stream on both games.  If generate, the turns are picked as it goes
+// and logged; otherwise the logged turns are played back.  Returns the tick
+// of the first mismatch, or NO_MISMATCH.
+uint32_t runStream(Checker* checkerp, Stream* streamp, bool generate) {
+    State* statep = &(checkerp->state);
+    RefGame* refp = &(checkerp->ref);
+    statep->gridWidth = streamp->gridWidth;
+    statep->gridHeight = streamp->gridHeight;
+    statep->snakeCount = streamp->snakeCount;
+    arenaReset(&(checkerp->arena));
+    initGame(statep, &(checkerp->arena));
+    refInit(refp, streamp->gridWidth, streamp->gridHeight, streamp->snakeCount);
+    seedRandom(statep, streamp->seed);
+    refp->rng = scrambleSeed(streamp->seed);
+    checkerp->inputRng = scrambleSeed(streamp->inputSeed);
+    if (generate) {
+        checkerp->turnCount = 0;
+    }
+
+    uint32_t mismatchTick = NO_MISMATCH;
+    size_t nextTurn = 0;
+    statep->crashed = true;
+    refp->crashed = true;
+    for (uint32_t n = 0; n < streamp->ticks && mismatchTick == NO_MISMATCH; n++) {
+        if (statep->crashed || refp->crashed) {
+            restart(statep);
+            refRestart(refp);
+            if (findMismatch(statep, refp, checkerp->what)) {
+                mismatchTick = statep->tickCount;
+                break;
+            }
+        }
+        for (uint8_t i = 0; i < streamp->snakeCount; i++) {
+            Turn* turnp = NULL;
+            if (generate) {
+                uint8_t direction = refp->snakes[i].crashed ? 0 : pickTurn(checkerp, streamp, i);
+                if (direction != 0) {
+                    turnp = &(checkerp->turnsp[checkerp->turnCount++]);
+                    turnp->tick = statep->tickCount;
+                    turnp->snake = i;
+                    turnp->direction = direction;
+                }
+            } else if (nextTurn < checkerp->turnCount && checkerp->turnsp[nextTurn].tick == statep->tickCount &&
+                checkerp->turnsp[nextTurn].snake == i) {
+                turnp = &(checkerp->turnsp[nextTurn++]);
+            }
+            if (turnp == NULL) {
+                continue;
+            }
+            bool accepted = turnSnake(&(statep->snakesp[i]), turnp->direction);
+            bool refAccepted = refTurn(&(refp->snakes[i]), turnp->direction);
+            turnp->accepted = accepted || refAccepted;
+            if (generate && turnp->accepted == false) {
+                // a no-op: don't log it.
+                checkerp->turnCount--;
+            }
+            if (accepted != refAccepted) {
+                snprintf(checkerp->what, MAX_WHAT, "snake %u turn %u: engine %d, reference %d",
+                    i, turnp->direction, accepted, refAccepted);
+                mismatchTick = statep->tickCount;
+                break;
+            }
+        }
+        if (mismatchTick != NO_MISMATCH) {
+            break;
+        }
+        moveSnake(statep);
+        refMove(refp);
+        if (findMismatch(statep, refp, checkerp->what)) {
+            mismatchTick = statep->tickCount;
+        }
+    }
+    refFree(refp);
+    return mismatchTick;
+}
+
+
+// Allocate a checker, with room for the largest board and to log every turn
+// of a stream.
+void checkerInit(Checker* checkerp, uint32_t ticks) {
+    State largest;
+    largest.gridWidth = MAX_DIFF_WIDTH;
+    largest.gridHeight = MAX_DIFF_HEIGHT;
+    largest.snakeCount = MAX_DIFF_SNAKES;
+    arenaInit(&(checkerp->arena), gameBytes(&largest));
+    checkerp->turnsp = malloc((size_t)ticks * MAX_DIFF_SNAKES * sizeof(Turn));
+    assert(checkerp->turnsp != NULL);
+    checkerp->turnCount = 0;
+}
+
+
+// Free a checker.
+void checkerFree(Checker* checkerp) {
+    arenaFree(&(checkerp->arena));
+    free(checkerp->turnsp);
+}
+
+
+// The worker thread: check streams a chunk at a time until they run out or
+// one fails.
+void* workerMain(void* argp) {
+    Worker* workerp = argp;
+    Run* runp = workerp->runp;
+    checkerInit(&(workerp->checker), runp->ticksPerStream);
+    workerp->ticks = 0;
+    while (true) {
+        pthread_mutex_lock(&(runp->lock));
+        size_t first = runp->next;
+        size_t last = first + CHUNK_SIZE < runp->streamCount ? first + CHUNK_SIZE : runp->streamCount;
+        if (runp->failedStream < last) {
+            // nothing past a failure matters.
+            last = first;
+        }
+        runp->next = last;
+        pthread_mutex_unlock(&(runp->lock));
+        if (first >= last) {
+            break;
+        }
+        for (size_t index = first; index < last; index++) {
+            Stream stream;
+            streamInit(&stream, index, runp->firstSeed, runp->ticksPerStream);
+            uint32_t mismatchTick = runStream(&(workerp->checker), &stream, true);
+            workerp->ticks += mismatchTick == NO_MISMATCH ? stream.ticks : mismatchTick;
+            if (mismatchTick != NO_MISMATCH) {
+                pthread_mutex_lock(&(runp->lock));
+                if (index < runp->failedStream) {
+                    runp->failedStream = index;
+                }
+                pthread_mutex_unlock(&(runp->lock));
+                break;
+            }
+        }
+    }
+    checkerFree(&(workerp->checker));
+    return NULL;
+}
+
+
+// Pare down a failing stream: stop it at the first mismatch, then drop runs
+// of turns, halving the run length, for as long as it still fails.  Returns
+// the tick of the mismatch of what is left.
+uint32_t shrinkStream(Checker* checkerp, Stream* streamp) {
+    uint32_t mismatchTick = runStream(checkerp, streamp, true);
+    assert(mismatchTick != NO_MISMATCH);
+    streamp->ticks = mismatchTick;
+    Turn* keptp = malloc((checkerp->turnCount + 1) * sizeof(Turn));
+    assert(keptp != NULL);
+    for (size_t chunk = (checkerp->turnCount + 1) / 2; chunk > 0; chunk /= 2) {
+        size_t start = 0;
+        while (start < checkerp->turnCount) {
+            size_t end = start + chunk < checkerp->turnCount ? start + chunk : checkerp->turnCount;
+            size_t keptCount = checkerp->turnCount;
+            memcpy(keptp, checkerp->turnsp, keptCount * sizeof(Turn));
+            memmove(checkerp->turnsp + start, checkerp->turnsp + end, (keptCount - end) * sizeof(Turn));
+            checkerp->turnCount = keptCount - (end - start);
+            uint32_t tick = runStream(checkerp, streamp, false);
+            if (tick != NO_MISMATCH) {
+                // still fails without them.
+                mismatchTick = tick;
+                streamp->ticks = tick;
+            } else {
+                memcpy(checkerp->turnsp, keptp, keptCount * sizeof(Turn));
+                checkerp->turnCount = keptCount;
+                start = end;
+            }
+        }
+        if (chunk == 1) {
+            break;
+        }
+    }
+    free(keptp);
+    // turns which became reversals once others were dropped do nothing, and
+    // a replay can't hold them.
+    size_t kept = 0;
+    for (size_t i = 0; i < checkerp->turnCount; i++) {
+        if (checkerp->turnsp[i].accepted) {
+            checkerp->turnsp[kept++] = checkerp->turnsp[i];
+        }
+    }
+    checkerp->turnCount = kept;
+    // run it once more, to leave the description of the mismatch.
+    mismatchTick = runStream(checkerp, streamp, false);
+    assert(mismatchTick != NO_MISMATCH);
+    return mismatchTick;
+}
+
+
+// Print a shrunk failing stream, and save it as a replay if the game can
+// play it back (one snake).
+void reportFailure(Checker* checkerp, Stream* streamp, uint32_t mismatchTick) {
+    printf("mismatch: stream %zu (board %ux%u, %u snakes, policy %u, seed %u) at tick %u: %s\n",
+        streamp->index, (unsigned)streamp->gridWidth, (unsigned)streamp->gridHeight, streamp->snakeCount,
+        streamp->policy, streamp->seed, mismatchTick, checkerp->what);
+    printf("shrunk to %u ticks and %zu turns:\n", streamp->ticks, checkerp->turnCount);
+    for (size_t i = 0; i < checkerp->turnCount; i++) {
+        Turn* turnp = &(checkerp->turnsp[i]);
+        printf("  tick %u snake %u direction %u\n", turnp->tick, turnp->snake, turnp->direction);
+    }
+    if (streamp->snakeCount != 1) {
+        return;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "difftest-%zu.rpl", streamp->index);
+    Recorder recorder;
+    State* statep = &(checkerp->state);
+    statep->gridWidth = streamp->gridWidth;
+    statep->gridHeight = streamp->gridHeight;
+    statep->tickCount = 0;
+    if (recorderOpen(&recorder, path, statep, streamp->seed) == false) {
+        fprintf(stderr, "can't create replay %s\n", path);
+        return;
+    }
+    for (size_t i = 0; i < checkerp->turnCount; i++) {
+        recordTurn(&recorder, checkerp->turnsp[i].tick, checkerp->turnsp[i].direction);
+    }
+    recorderClose(&recorder, streamp->ticks);
+    printf("replay: %s (snake --replay %s)\n", path, path);
+}
+
+
+// The differential test entry point.  Exits with 1 if any stream failed.
+// usage: snake-difftest [streams [ticksPerStream [threads [firstSeed]]]]
+int main(int argc, char** argv) {
+    Run run;
+    run.streamCount = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+    run.ticksPerStream = argc > 2 ? strtoul(argv[2], NULL, 0) : 100;
+    size_t threadCount = argc > 3 ? strtoul(argv[3], NULL, 0) : (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    run.firstSeed = argc > 4 ? strtoul(argv[4], NULL, 0) : 1;
+    assert(run.streamCount > 0 && run.ticksPerStream > 0 && threadCount > 0);
+    pthread_mutex_init(&(run.lock), NULL);
+    run.next = 0;
+    run.failedStream = run.streamCount;
+
+    Worker* workersp = calloc(threadCount, sizeof(Worker));
+    assert(workersp != NULL);
+    uint64_t startNs = nowNs();
+    for (size_t i = 0; i < threadCount; i++) {
+        workersp[i].runp = &run;
+        int ret = pthread_create(&(workersp[i].thread), NULL, workerMain, &(workersp[i]));
+        assert(ret == 0);
+    }
+    uint64_t ticks = 0;
+    for (size_t i = 0; i < threadCount; i++) {
+        pthread_join(workersp[i].thread, NULL);
+        ticks += workersp[i].ticks;
+    }
+    uint64_t endNs = nowNs();
+    free(workersp);
+    pthread_mutex_destroy(&(run.lock));
+
+    printf("streams: %zu of %u ticks, %zu threads\n", run.streamCount, run.ticksPerStream, threadCount);
+    printf("ticks: %llu in %.1f s (%.0f per second)\n", (unsigned long long)ticks,
+        (endNs - startNs) / 1e9, ticks * 1e9 / (endNs - startNs));
+    if (run.failedStream == run.streamCount) {
+        printf("mismatches: 0\n");
+        return 0;
+    }
+    Checker checker;
+    checkerInit(&checker, run.ticksPerStream);
+    Stream stream;
+    streamInit(&stream, run.failedStream, run.firstSeed, run.ticksPerStream);
+    uint32_t mismatchTick = shrinkStream(&checker, &stream);
+    reportFailure(&checker, &stream, mismatchTick);
+    checkerFree(&checker);
+    return 1;
+}
@@ -0,0 +1,435 @@
+// The headless snake engine: game state and rules, with no SDL dependency.
+// Copyright 2020 Jason Pepas, 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "engine.h"
+
+#include <string.h>  // memset
+
+
+// Turn an arbitrary seed into a valid (non-zero) xorshift32 state.
+uint32_t scrambleSeed(uint32_t seed) {
+    // scramble the seed (murmur3 finalizer), so that nearby seeds do not
+    // produce similar sequences.
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6B;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35;
+    seed ^= seed >> 16;
+    // xorshift gets stuck at zero.
+    if (seed == 0) {
+        seed = 0x9E3779B9;
+    }
+    return seed;
+}
+
+
+// Return the next number from a xorshift32 generator.
+uint32_t xorshift32(uint32_t* rngp) {
+    uint32_t x = *rngp;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *rngp = x;
+    return x;
+}
+
+
+// Seed the game's random number generator.  Any seed is valid, and the same
+// seed always gives the same sequence of games.
+void seedRandom(State* statep, uint32_t seed) {
+    statep->rng = scrambleSeed(seed);
+}
+
+
+// Return the next number from the game's random number generator.
+uint32_t nextRandom(State* statep) {
+    return xorshift32(&(statep->rng));
+}
+
+
+// Return the capacity of a ring for count blocks: a power of two, more than
+// count.  The spare slot keeps the link from the tail to the cell it has just
+// left, even when the snake covers the whole board.
+static size_t ringCapacity(size_t count) {
+    // at least one whole byte of links.
+    size_t capacity = 4;
+    while (capacity <= count) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+
+// Initialize a ring buffer with room for more than count blocks, taken from
+// an arena.
+void ringInit(Ring* ringp, size_t count, Arena* arenap) {
+    size_t capacity = ringCapacity(count);
+    ringp->linksp = arenaAlloc(arenap, capacity / 4);
+    ringp->mask = capacity - 1;
+}
+
+
+// Return the index of a grid cell in the occupancy bitmap and free set.
+static size_t cellIndex(State* statep, Coord x, Coord y) {
+    return (size_t)y * boardWidth(statep) + x;
+}
+
+
+// Is the grid cell covered by the snake?
+bool isOccupied(State* statep, Coord x, Coord y) {
+    size_t i = cellIndex(statep, x, y);
+    return (statep->occupiedp[i >> 3] >> (i & 7)) & 1;
+}
+
+
+// Mark a grid cell as covered by the snake.  The cell must be free.
+static void setOccupied(State* statep, Coord x, Coord y) {
+    size_t i = cellIndex(statep, x, y);
+    statep->occupiedp[i >> 3] |= (uint8_t)(1 << (i & 7));
+
+    // move the last free cell into the vacated slot.
+    Cell slot = statep->freeSlotsp[i];
+    statep->freeCount--;
+    Cell lastCell = statep->freeCellsp[statep->freeCount];
+    statep->freeCellsp[slot] = lastCell;
+    statep->freeSlotsp[lastCell] = slot;
+}
+
+
+// Mark a grid cell as no longer covered by the snake.  The cell must be
+// occupied.
+static void clearOccupied(State* statep, Coord x, Coord y) {
+    size_t i = cellIndex(statep, x, y);
+    statep->occupiedp[i >> 3] &= (uint8_t)~(1 << (i & 7));
+
+    statep->freeCellsp[statep->freeCount] = i;
+    statep->freeSlotsp[i] = statep->freeCount;
+    statep->freeCount++;
+}
+
+
+// Does the food block collide with the snake?
+bool foodCollidesWithSnake(State* statep) {
+    return isOccupied(statep, statep->food.x, statep->food.y);
+}
+
+
+// Respawn the food into a new location which does not collide with the snake.
+// Returns false if the snake fills the board and there is nowhere left.
+bool respawnFood(State* statep) {
+    if (statep->freeCount == 0) {
+        return false;
+    }
+    Cell cell = statep->freeCellsp[nextRandom(statep) % statep->freeCount];
+    statep->food.x = cell % boardWidth(statep);
+    statep->food.y = cell / boardWidth(statep);
+    assert(foodCollidesWithSnake(statep) == false);
+    return true;
+}
+
+
+// Does the head of a snake collide with a body, its own or another's?
+// Must be called before the new head is marked in the occupancy bitmap.
+bool snakeCollidesWithSnake(State* statep, Snake* snakep) {
+    SnakeNode* headp = snakeHead(snakep);
+    return isOccupied(statep, headp->x, headp->y);
+}
+
+
+// Would a snake be out of bounds after advancing its head?
+bool wouldBeOutOfBounds(State* statep, Snake* snakep) {
+    SnakeNode next = *snakeHead(snakep);
+    stepOnBoard(statep, &next, snakep->direction);
+    return next.x == OFF_BOARD || next.y == OFF_BOARD;
+}
+
+
+// Is the grid cell a wall of the level?
+static bool isWall(State* statep, Coord x, Coord y) {
+    size_t i = cellIndex(statep, x, y);
+    return statep->wallsp != NULL && ((statep->wallsp[i >> 3] >> (i & 7)) & 1);
+}
+
+
+// Return the opposite direction (UP <-> DOWN, RIGHT <-> LEFT).
+uint8_t reverseDirection(uint8_t direction) {
+    return (direction + 1) % 4 + 1;
+}
+
+
+// Point a snake in a new direction, unless that would reverse it onto
+// itself.  Returns true if the direction was accepted.
+bool turnSnake(Snake* snakep, uint8_t direction) {
+    if (direction == reverseDirection(snakep->direction)) {
+        return false;
+    }
+    snakep->direction = direction;
+    return true;
+}
+
+
+// Mark a snake as crashed.  The game is over once they all have.
+static void crashSnake(State* statep, Snake* snakep, uint8_t cause) {
+    snakep->crashed = true;
+    snakep->crashCause = cause;
+    statep->aliveCount--;
+    if (statep->aliveCount == 0) {
+        statep->crashed = true;
+        statep->crashCause = cause;
+    }
+}
+
+
+// Advance one snake by one block.  A snake which would crash is left as it
+// is, so that every one of its cells stays occupied.
+static void advanceSnake(State* statep, Snake* snakep) {
+    SnakeNode next = *snakeHead(snakep);
+    stepOnBoard(statep, &next, snakep->direction);
+    if (next.x == OFF_BOARD || next.y == OFF_BOARD) {
+        crashSnake(statep, snakep, CRASH_WALL);
+        return;
+    }
+
+    // the tail moves out of the way first, unless the snake grows, so the
+    // head may follow it into its cell.
+    bool didEat = next.x == statep->food.x && next.y == statep->food.y;
+    SnakeNode* tailp = snakeTail(snakep);
+    bool intoTail = didEat == false && next.x == tailp->x && next.y == tailp->y;
+    if (isOccupied(statep, next.x, next.y) && intoTail == false) {
+        // a wall is just a cell which is always occupied.
+        crashSnake(statep, snakep, isWall(statep, next.x, next.y) ? CRASH_WALL : CRASH_SELF);
+        return;
+    }
+
+    Ring* ringp = &(snakep->ring);
+    snakep->head = ringPrev(ringp, snakep->head);
+    ringSetLink(ringp, snakep->head, reverseDirection(snakep->direction));
+    *snakeHead(snakep) = next;
+    if (didEat == false) {
+        clearOccupied(statep, tailp->x, tailp->y);
+        snakep->tail = ringPrev(ringp, snakep->tail);
+        stepOnBoard(statep, tailp, reverseDirection(ringLink(ringp, snakep->tail)));
+    }
+    setOccupied(statep, next.x, next.y);
+
+    // the food can only be respawned once the new head is in the bitmap.
+    if (didEat && respawnFood(statep) == false) {
+        // the snakes fill the board, so the game is over.
+        statep->crashed = true;
+        statep->crashCause = CRASH_FULL;
+    }
+}
+
+
+// Advance every live snake by one block.  This is the simulation step.  Each
+// snake sees the board as the snakes before it have left it: only the live
+// snakes are moved, so a tick costs as much per snake whatever their length.
+void moveSnake(State* statep) {
+    if (statep->crashed) {
+        return;
+    }
+    statep->tickCount++;
+    for (uint8_t i = 0; i < statep->snakeCount && statep->crashed == false; i++) {
+        Snake* snakep = &(statep->snakesp[i]);
+        if (snakep->crashed == false) {
+            advanceSnake(statep, snakep);
+        }
+    }
+}
+
+
+// Mark every cell of the board as free, but for the walls of the level.
+static void clearBoard(State* statep) {
+    size_t cellCount = (size_t)boardWidth(statep) * boardHeight(statep);
+    if (statep->wallsp != NULL) {
+        memcpy(statep->occupiedp, statep->wallsp, (cellCount + 7) / 8);
+        memcpy(statep->freeCellsp, statep->levelCellsp, statep->openCount * sizeof(Cell));
+        memcpy(statep->freeSlotsp, statep->levelSlotsp, cellCount * sizeof(Cell));
+        statep->freeCount = statep->openCount;
+        return;
+    }
+    memset(statep->occupiedp, 0, (cellCount + 7) / 8);
+    for (size_t i = 0; i < cellCount; i++) {
+        statep->freeCellsp[i] = i;
+        statep->freeSlotsp[i] = i;
+    }
+    statep->freeCount = cellCount;
+}
+
+
+// Restart: start a new game.
+void restart(State* statep) {
+    clearBoard(statep);
+    for (uint8_t i = 0; i < statep->snakeCount; i++) {
+        Snake* snakep = &(statep->snakesp[i]);
+        snakep->head = 0;
+        snakep->tail = 0;
+        SnakeNode* headp = snakeHead(snakep);
+        if (i == 0 && statep->wallsp == NULL) {
+            // the first snake draws its place as it always has, so that a
+            // seed gives the same single player games.
+            headp->x = nextRandom(statep) % boardWidth(statep);
+            headp->y = nextRandom(statep) % boardHeight(statep);
+        } else {
+            Cell cell = statep->freeCellsp[nextRandom(statep) % statep->freeCount];
+            headp->x = cell % boardWidth(statep);
+            headp->y = cell / boardWidth(statep);
+        }
+        snakep->tailNode = *headp;
+        setOccupied(statep, headp->x, headp->y);
+
+        snakep->crashed = false;
+        snakep->crashCause = CRASH_NONE;
+        if (headp->x > boardWidth(statep) / 2) {
+            snakep->direction = LEFT;
+        } else {
+            snakep->direction = RIGHT;
+        }
+    }
+    statep->aliveCount = statep->snakeCount;
+
+    respawnFood(statep);
+
+    statep->crashed = false;
+    statep->crashCause = CRASH_NONE;
+}
+
+
+// Make each snake as long as lengthsp says, from its head position and the
+// first links of its ring, and rebuild the tails and the occupancy around
+// them.  This is how a saved game is resumed: the food, directions and
+// generator are left to the caller.  Returns false if the blocks don't fit in
+// the free cells, are off the board or overlap.
+bool placeSnakes(State* statep, const Cell* lengthsp) {
+    clearBoard(statep);
+    for (uint8_t i = 0; i < statep->snakeCount; i++) {
+        Snake* snakep = &(statep->snakesp[i]);
+        Cell length = lengthsp[i];
+        if (length == 0 || length > statep->freeCount) {
+            return false;
+        }
+        snakep->head = 0;
+        snakep->tail = length - 1;
+
+        // stepping off an edge which doesn't wrap gives OFF_BOARD, so the
+        // bounds check catches that too.
+        SnakeNode block = snakep->headNode;
+        for (Cell j = 0; j < length; j++) {
+            if (j > 0) {
+                stepOnBoard(statep, &block, ringLink(&(snakep->ring), j - 1));
+            }
+            if (block.x >= boardWidth(statep) || block.y >= boardHeight(statep) ||
+                isOccupied(statep, block.x, block.y)) {
+                return false;
+            }
+            setOccupied(statep, block.x, block.y);
+        }
+        snakep->tailNode = block;
+        snakep->crashed = false;
+        snakep->crashCause = CRASH_NONE;
+    }
+    statep->aliveCount = statep->snakeCount;
+
+    statep->crashed = false;
+    statep->crashCause = CRASH_NONE;
+    return true;
+}
+
+
+// Fill in the step table of one axis of side cells: where a step of -1, 0
+// and +1 leads from each.
+static void fillSteps(Coord* stepsp, Coord side, bool wrap) {
+    for (Coord i = 0; i < side; i++) {
+        stepsp[i] = i > 0 ? i - 1 : wrap ? side - 1 : OFF_BOARD;
+        stepsp[side + i] = i;
+        stepsp[2 * side + i] = i + 1 < side ? i + 1 : wrap ? 0 : OFF_BOARD;
+    }
+}
+
+
+// Allocate the game buffers from an arena, which must have gameBytes() to
+// spare.  The grid dimensions and the number of snakes must already be set.
+// Nothing is allocated after this: restart() reuses the same buffers.
+void initGame(State* statep, Arena* arenap) {
+    assert(statep->gridWidth > 0 && statep->gridWidth <= MAX_GRID_SIDE);
+    assert(statep->gridHeight > 0 && statep->gridHeight <= MAX_GRID_SIDE);
+    // a build for one board size plays no other.
+    assert(statep->gridWidth == boardWidth(statep) && statep->gridHeight == boardHeight(statep));
+    size_t count = (size_t)statep->gridWidth * statep->gridHeight;
+    // every snake needs a cell to start in.
+    assert(statep->snakeCount > 0 && statep->snakeCount <= count);
+
+    statep->snakesp = arenaAlloc(arenap, statep->snakeCount * sizeof(Snake));
+    // any one snake may grow to cover the board.
+    for (uint8_t i = 0; i < statep->snakeCount; i++) {
+        ringInit(&(statep->snakesp[i].ring), count, arenap);
+    }
+    statep->occupiedp = arenaAlloc(arenap, (count + 7) / 8);
+    statep->freeCellsp = arenaAlloc(arenap, count * sizeof(Cell));
+    statep->freeSlotsp = arenaAlloc(arenap, count * sizeof(Cell));
+    statep->stepXp = arenaAlloc(arenap, 3 * statep->gridWidth * sizeof(Coord));
+    statep->stepYp = arenaAlloc(arenap, 3 * statep->gridHeight * sizeof(Coord));
+    fillSteps(statep->stepXp, statep->gridWidth, false);
+    fillSteps(statep->stepYp, statep->gridHeight, false);
+    statep->wallsp = NULL;
+    statep->openCount = count;
+
+    statep->tickCount = 0;
+}
+
+
+// Return the number of arena bytes initGame() takes.  Only the grid
+// dimensions and the number of snakes need be set.
+size_t gameBytes(State* statep) {
+    size_t count = (size_t)statep->gridWidth * statep->gridHeight;
+    size_t bytes = arenaRound(statep->snakeCount * sizeof(Snake));
+    bytes += statep->snakeCount * arenaRound(ringCapacity(count) / 4);
+    bytes += arenaRound((count + 7) / 8);
+    bytes += arenaRound(3 * statep->gridWidth * sizeof(Coord)) + arenaRound(3 * statep->gridHeight * sizeof(Coord));
+    return bytes + 2 * arenaRound(count * sizeof(Cell));
+}
+
+
+// Return the number of arena bytes setLevel() takes.  The grid dimensions
+// must be set.
+size_t levelBytes(State* statep) {
+    size_t count = (size_t)statep->gridWidth * statep->gridHeight;
+    return 2 * arenaRound(count * sizeof(Cell));
+}
+
+
+// Play on a level: wallsp has a bit set for every wall cell, in the layout
+// of the occupancy bitmap, and must stay valid for the life of the game.  If
+// wrap is set, the snakes go off one edge and come back on at the other.
+// Call after initGame() and before restart(), with levelBytes() to spare in
+// the arena.  Returns false if the level leaves too little room to play.
+bool setLevel(State* statep, const uint8_t* wallsp, bool wrap, Arena* arenap) {
+    size_t count = (size_t)statep->gridWidth * statep->gridHeight;
+    statep->levelCellsp = arenaAlloc(arenap, count * sizeof(Cell));
+    statep->levelSlotsp = arenaAlloc(arenap, count * sizeof(Cell));
+    // the free set of the empty level, in cell order; the walls get no slot.
+    Cell openCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        if ((wallsp[i >> 3] >> (i & 7)) & 1) {
+            continue;
+        }
+        statep->levelCellsp[openCount] = i;
+        statep->levelSlotsp[i] = openCount;
+        openCount++;
+    }
+    // every snake needs a cell to start in, and the food one more.
+    if (openCount <= statep->snakeCount) {
+        return false;
+    }
+    statep->wallsp = wallsp;
+    statep->openCount = openCount;
+    fillSteps(statep->stepXp, statep->gridWidth, wrap);
+    fillSteps(statep->stepYp, statep->gridHeight, wrap);
+    return true;
+}
@@ -0,0 +1,322 @@
+// The headless snake engine: game state and rules, with no SDL dependency.
+// Copyright 2020 Jason Pepas, 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "arena.h"
+
+#include <stdint.h>  // uint8_t
+#include <stddef.h>  // size_t
+#include <assert.h>  // assert
+#include <stdbool.h>  // true
+#include <stdlib.h>  // exit
+
+#define unreachable assert(false);exit(99);
+
+
+// Board coordinates, and cell indices (y * gridWidth + x).  The device build
+// keeps them as small as its boards allow.  Build with -DLARGE_BOARDS for
+// boards of up to 4096x4096, as used for headless bot training.
+#ifdef LARGE_BOARDS
+typedef uint16_t Coord;
+typedef uint32_t Cell;
+#define MAX_GRID_SIDE 4096
+#else
+typedef uint8_t Coord;
+typedef uint16_t Cell;
+#define MAX_GRID_SIDE 255
+#endif
+
+// A coordinate past an edge of the board which doesn't wrap round.  Never a
+// real coordinate, since no side is longer than MAX_GRID_SIDE.
+#define OFF_BOARD ((Coord)~0)
+
+// The board size is set at runtime, from --board, a level or a replay.
+// Build with -DBOARD_WIDTH=W -DBOARD_HEIGHT=H to fix it at WxH instead:
+// boardWidth() and boardHeight() are then constants, so every cell index
+// and step the engine works out folds them in, and initGame() takes no
+// other size.
+#if defined(BOARD_WIDTH) != defined(BOARD_HEIGHT)
+#error "BOARD_WIDTH and BOARD_HEIGHT go together"
+#endif
+#if defined(BOARD_WIDTH) && (BOARD_WIDTH < 1 || BOARD_WIDTH > MAX_GRID_SIDE || BOARD_HEIGHT < 1 || \
+    BOARD_HEIGHT > MAX_GRID_SIDE)
+#error "BOARD_WIDTH and BOARD_HEIGHT must be from 1 to MAX_GRID_SIDE"
+#endif
+
+
+#define UP 1
+#define RIGHT 2
+#define DOWN 3
+#define LEFT 4
+
+// Why the game ended.
+#define CRASH_NONE 0
+#define CRASH_WALL 1  // ran into the edge of the board, or a wall of the level.
+#define CRASH_SELF 2  // ran into a body: its own, or another snake's.
+#define CRASH_FULL 3  // filled the board: nowhere left to put food.
+
+#define MAX_SNAKES 255
+
+
+// The position of one block of a snake body.
+struct _SnakeNode {
+    Coord x;
+    Coord y;
+};
+typedef struct _SnakeNode SnakeNode;
+
+
+// A ring buffer of the links between snake blocks, addressed by index.  The
+// link at index i is the direction from block i to block i + 1, one block
+// nearer the tail, packed into two bits (the direction less one), four to a
+// byte.  Only the head and tail positions are kept: the blocks in between are
+// found by following the links from the head.  The capacity is a power of
+// two, so stepping round the ring is an add and a mask: no compare and no
+// branch.
+struct _Ring {
+    uint8_t* linksp;
+    uint32_t mask;  // the capacity, less one.
+};
+typedef struct _Ring Ring;
+
+
+// One snake: its body, and where it is heading.
+struct _Snake {
+    // the body runs from head to tail, towards higher indices.  Just after a
+    // move, the link at the tail points at the cell the tail has just left.
+    Ring ring;
+    uint32_t head;
+    uint32_t tail;
+    SnakeNode headNode;
+    SnakeNode tailNode;
+
+    uint8_t direction;
+    bool crashed;  // a crashed snake stays put, in the way, until restart().
+    uint8_t crashCause;
+};
+typedef struct _Snake Snake;
+
+
+// A block of food.
+struct _Food {
+    Coord x;
+    Coord y;
+};
+typedef struct _Food Food;
+
+
+// The game state: one board, shared by one or more snakes.  Every snake
+// moves once per tick, in index order, so the lower index always has the
+// right of way and a tick comes out the same wherever it is run.
+struct _State {
+    Coord gridWidth;  // at most MAX_GRID_SIDE.
+    Coord gridHeight;
+
+    // the game is over: every snake has crashed, or the board is full.
+    bool crashed;
+    uint8_t crashCause;  // of the last snake to crash, or CRASH_FULL.
+    uint32_t tickCount;  // moves simulated since initGame(), across restarts.
+
+    // where a step leads from each column: the column to its left, itself
+    // and the one to its right, at (dx + 1) * gridWidth + x; and the same
+    // for rows.  OFF_BOARD past an edge, unless the level wraps round.  The
+    // move looks the new head up, so wrapping costs no branch.
+    Coord* stepXp;
+    Coord* stepYp;
+
+    Snake* snakesp;
+    uint8_t snakeCount;  // at most MAX_SNAKES.
+    uint8_t aliveCount;  // the snakes which haven't crashed.
+
+    // One bit per grid cell, set for every cell covered by a snake.
+    uint8_t* occupiedp;
+
+    // The set of cells not covered by any snake: a dense array of cell
+    // indices, plus the position of each cell within that array.
+    Cell* freeCellsp;
+    Cell* freeSlotsp;
+    Cell freeCount;
+
+    // The walls of the level, if there is one, in the layout of the
+    // occupancy bitmap: cells which are always occupied.  restart() copies
+    // the board from them and from the free set of the empty level, worked
+    // out once, so a level costs nothing per tick.
+    const uint8_t* wallsp;
+    Cell* levelCellsp;
+    Cell* levelSlotsp;
+    Cell openCount;  // the cells which aren't walls.
+
+    Food food;
+
+    // The state of this game's random number generator (xorshift32).
+    // Never zero.
+    uint32_t rng;
+};
+typedef struct _State State;
+
+
+// Turn an arbitrary seed into a valid (non-zero) xorshift32 state.
+uint32_t scrambleSeed(uint32_t seed);
+
+// Return the next number from a xorshift32 generator.
+uint32_t xorshift32(uint32_t* rngp);
+
+// Seed the game's random number generator.  Any seed is valid, and the same
+// seed always gives the same sequence of games.
+void seedRandom(State* statep, uint32_t seed);
+
+// Return the next number from the game's random number generator.
+uint32_t nextRandom(State* statep);
+
+// Initialize a ring buffer with room for more than count blocks, taken from
+// an arena.
+void ringInit(Ring* ringp, size_t count, Arena* arenap);
+
+// Return the next index in a ring buffer (one block towards the tail).
+static inline uint32_t ringNext(Ring* ringp, uint32_t i) {
+    return (i + 1) & ringp->mask;
+}
+
+// Return the previous index in a ring buffer (one block towards the head).
+static inline uint32_t ringPrev(Ring* ringp, uint32_t i) {
+    return (i - 1) & ringp->mask;
+}
+
+// Return the direction from the block at index i to the next one.
+static inline uint8_t ringLink(Ring* ringp, uint32_t i) {
+    return ((ringp->linksp[i >> 2] >> ((i & 3) * 2)) & 3) + 1;
+}
+
+// Set the direction from the block at index i to the next one.
+static inline void ringSetLink(Ring* ringp, uint32_t i, uint8_t direction) {
+    uint8_t shift = (i & 3) * 2;
+    uint8_t* bytep = &(ringp->linksp[i >> 2]);
+    *bytep = (*bytep & ~(3 << shift)) | ((direction - 1) << shift);
+}
+
+// Move a position one block in direction, without any bounds check.
+static inline void stepNode(SnakeNode* nodep, uint8_t direction) {
+    nodep->x += (direction == RIGHT) - (direction == LEFT);
+    nodep->y += (direction == DOWN) - (direction == UP);
+}
+
+// Return the width of the board: a constant in a build for one board size.
+static inline Coord boardWidth(State* statep) {
+#ifdef BOARD_WIDTH
+    (void)statep;
+    return BOARD_WIDTH;
+#else
+    return statep->gridWidth;
+#endif
+}
+
+// Return the height of the board: a constant in a build for one board size.
+static inline Coord boardHeight(State* statep) {
+#ifdef BOARD_HEIGHT
+    (void)statep;
+    return BOARD_HEIGHT;
+#else
+    return statep->gridHeight;
+#endif
+}
+
+// Move a position one block in direction across the board: off it, as
+// OFF_BOARD, or round to the other side if the level wraps.
+static inline void stepOnBoard(State* statep, SnakeNode* nodep, uint8_t direction) {
+    int dx = (direction == RIGHT) - (direction == LEFT);
+    int dy = (direction == DOWN) - (direction == UP);
+    nodep->x = statep->stepXp[(dx + 1) * boardWidth(statep) + nodep->x];
+    nodep->y = statep->stepYp[(dy + 1) * boardHeight(statep) + nodep->y];
+}
+
+// Return the first snake: the player's, in a single player game.
+static inline Snake* playerSnake(State* statep) {
+    return &(statep->snakesp[0]);
+}
+
+// Return the head block of a snake.
+static inline SnakeNode* snakeHead(Snake* snakep) {
+    return &(snakep->headNode);
+}
+
+// Return the tail block of a snake.
+static inline SnakeNode* snakeTail(Snake* snakep) {
+    return &(snakep->tailNode);
+}
+
+// Return the number of blocks in a snake.
+static inline uint32_t snakeLength(Snake* snakep) {
+    return ((snakep->tail - snakep->head) & snakep->ring.mask) + 1;
+}
+
+// Return the number of cells covered by snakes.
+static inline Cell coveredCells(State* statep) {
+    return statep->openCount - statep->freeCount;
+}
+
+// Is the grid cell covered by the snake?
+bool isOccupied(State* statep, Coord x, Coord y);
+
+// Does the food block collide with the snake?
+bool foodCollidesWithSnake(State* statep);
+
+// Respawn the food into a new location which does not collide with the snake.
+// Returns false if the snake fills the board and there is nowhere left.
+bool respawnFood(State* statep);
+
+// Does the head of a snake collide with a body, its own or another's?
+// Must be called before the new head is marked in the occupancy bitmap.
+bool snakeCollidesWithSnake(State* statep, Snake* snakep);
+
+// Would a snake be out of bounds after advancing its head?
+bool wouldBeOutOfBounds(State* statep, Snake* snakep);
+
+// Return the opposite direction (UP <-> DOWN, RIGHT <-> LEFT).
+uint8_t reverseDirection(uint8_t direction);
+
+// Point a snake in a new direction, unless that would reverse it onto
+// itself.  Returns true if the direction was accepted.
+bool turnSnake(Snake* snakep, uint8_t direction);
+
+// Advance every live snake by one block.  This is the simulation step.
+void moveSnake(State* statep);
+
+// Restart: start a new game.
+void restart(State* statep);
+
+// Make each snake as long as lengthsp says, from its head position and the
+// first links of its ring, and rebuild the tails and the occupancy around
+// them.  This is how a saved game is resumed: the food, directions and
+// generator are left to the caller.  Returns false if the blocks don't fit in
+// the free cells, are off the board or overlap.
+bool placeSnakes(State* statep, const Cell* lengthsp);
+
+// Allocate the game buffers from an arena, which must have gameBytes() to
+// spare.  The grid dimensions and the number of snakes must already be set.
+// Nothing is allocated after this: restart() reuses the same buffers.
+void initGame(State* statep, Arena* arenap);
+
+// Return the number of arena bytes initGame() takes.  Only the grid
+// dimensions and the number of snakes need be set.
+size_t gameBytes(State* statep);
+
+// Return the number of arena bytes setLevel() takes.  The grid dimensions
+// must be set.
+size_t levelBytes(State* statep);
+
+// Play on a level: wallsp has a bit set for every wall cell, in the layout
+// of the occupancy bitmap, and must stay valid for the life of the game.  If
+// wrap is set, the snakes go off one edge and come back on at the other.
+// Call after initGame() and before restart(), with levelBytes() to spare in
+// the arena.  Returns false if the level leaves too little room to play.
+bool setLevel(State* statep, const uint8_t* wallsp, bool wrap, Arena* arenap);
+
+#endif
@@ -0,0 +1,91 @@
+// Level maps: walls and obstacles, and whether the edges wrap round.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "level.h"
+
+#include <stdio.h>  // fopen, fwrite
+#include <string.h>  // memcmp
+#include <fcntl.h>  // open
+#include <unistd.h>  // close
+#include <sys/mman.h>  // mmap, munmap
+#include <sys/stat.h>  // fstat
+
+
+// Return the size of the walls of a level.
+static size_t wallsSize(Coord gridWidth, Coord gridHeight) {
+    return ((size_t)gridWidth * gridHeight + 7) / 8;
+}
+
+
+// Map a level file.  Returns false if it can't be read, isn't a valid level
+// or leaves no room for a snake and its food.
+bool levelOpen(Level* levelp, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < LEVEL_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+    void* datap = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (datap == MAP_FAILED) {
+        return false;
+    }
+    const uint8_t* h = datap;
+    Coord gridWidth = h[5];
+    Coord gridHeight = h[6];
+    size_t count = (size_t)gridWidth * gridHeight;
+    bool ok = memcmp(h, "SNKL", 4) == 0 && h[4] == LEVEL_VERSION && gridWidth > 0 && gridHeight > 0 &&
+        (size_t)st.st_size == LEVEL_HEADER_SIZE + wallsSize(gridWidth, gridHeight);
+    // a stray bit past the last cell would be counted as a wall.
+    if (ok && count % 8 != 0) {
+        ok = (h[st.st_size - 1] >> (count % 8)) == 0;
+    }
+    // room for a snake and the food, at least.
+    size_t wallCount = 0;
+    for (size_t i = LEVEL_HEADER_SIZE; ok && i < (size_t)st.st_size; i++) {
+        wallCount += __builtin_popcount(h[i]);
+    }
+    ok = ok && wallCount + 2 <= count;
+    if (ok == false) {
+        munmap(datap, st.st_size);
+        return false;
+    }
+    levelp->gridWidth = gridWidth;
+    levelp->gridHeight = gridHeight;
+    levelp->wrap = (h[7] & LEVEL_WRAP) != 0;
+    levelp->wallsp = h + LEVEL_HEADER_SIZE;
+    levelp->datap = datap;
+    levelp->size = st.st_size;
+    return true;
+}
+
+
+// Unmap a level.  The game must be done with its walls.
+void levelClose(Level* levelp) {
+    munmap((void*)levelp->datap, levelp->size);
+    levelp->datap = NULL;
+    levelp->wallsp = NULL;
+}
+
+
+// Write a level file.  Returns false if it can't be written.
+bool levelSave(const char* path, Coord gridWidth, Coord gridHeight, bool wrap, const uint8_t* wallsp) {
+    FILE* filep = fopen(path, "wb");
+    if (filep == NULL) {
+        return false;
+    }
+    uint8_t h[LEVEL_HEADER_SIZE] = {'S', 'N', 'K', 'L', LEVEL_VERSION, gridWidth, gridHeight, wrap ? LEVEL_WRAP : 0};
+    bool ok = fwrite(h, sizeof(h), 1, filep) == 1 &&
+        fwrite(wallsp, wallsSize(gridWidth, gridHeight), 1, filep) == 1;
+    return fclose(filep) == 0 && ok;
+}
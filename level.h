@@ -0,0 +1,59 @@
+// Level maps: walls and obstacles, and whether the edges wrap round.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// A level file is an 8 byte header followed by the walls, one bit per cell.
+//
+//   header: "SNKL", version, gridWidth, gridHeight, flags
+//   walls:  (gridWidth * gridHeight + 7) / 8 bytes: the bit for cell
+//           i = y * gridWidth + x is bit i & 7 of byte i >> 3
+//
+// which is the layout of the occupancy bitmap, so the walls are used
+// straight out of the mapped file: nothing is parsed or converted.  With
+// LEVEL_WRAP in the flags, a snake going off one edge comes back on at the
+// other.  The spare bits of the last byte must be clear.  snake-mklevel
+// makes level files from text pictures.
+
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include "engine.h"
+
+#include <stdint.h>  // uint8_t
+#include <stdbool.h>  // bool
+#include <stddef.h>  // size_t
+
+#define LEVEL_VERSION 1
+#define LEVEL_HEADER_SIZE 8
+#define LEVEL_WRAP 0x01
+
+
+// A level, mapped from its file.
+struct _Level {
+    Coord gridWidth;
+    Coord gridHeight;
+    bool wrap;
+    const uint8_t* wallsp;  // within the mapping.
+
+    const uint8_t* datap;  // the whole file.
+    size_t size;
+};
+typedef struct _Level Level;
+
+
+// Map a level file.  Returns false if it can't be read, isn't a valid level
+// or leaves no room for a snake and its food.
+bool levelOpen(Level* levelp, const char* path);
+
+// Unmap a level.  The game must be done with its walls.
+void levelClose(Level* levelp);
+
+// Write a level file.  Returns false if it can't be written.
+bool levelSave(const char* path, Coord gridWidth, Coord gridHeight, bool wrap, const uint8_t* wallsp);
+
+#endif
@@ -0,0 +1,370 @@
+// Microbenchmarks of the hot paths, with a regression check against a
+// stored baseline.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// Every function is timed with the snake held at a fixed share of the board,
+// laid along the benchmark cycle.  Each result is the best of several rounds,
+// since noise only ever makes a round slower.  The results go to stdout as
+// JSON, so that a run saved to a file is itself a baseline for later runs;
+// regressions are reported on stderr.  Rendering goes to an offscreen surface
+// in the panel's RGB565 format, so nothing is shown and no display is needed.
+
+#include "engine.h"
+#include "cycle.h"
+#include "tiles.h"
+#include "raster.h"
+
+#include <stdint.h>  // uint64_t
+#include <stdio.h>  // printf, fopen, fgets, sscanf
+#include <stdlib.h>  // atof, setenv
+#include <string.h>  // strcmp
+#include <time.h>  // clock_gettime
+
+#define REPEATS 5  // rounds per result, of which the fastest counts.
+#define MOVE_CALLS (1 << 16)  // calls per round.
+#define RESPAWN_CALLS (1 << 16)
+#define COLLIDE_CALLS (1 << 20)
+#define DRAW_CALLS (1 << 10)
+#define MAX_CELL_SIZE 16
+#define MAX_SURFACE_SIDE 4096  // keeps every cell within an SDL_Rect.
+#define MAX_NAME 32
+
+// The shares of the board the snake covers, in percent.
+static const int fills[] = {10, 50, 90, 99};
+#define FILL_COUNT (sizeof(fills) / sizeof(fills[0]))
+#define BENCH_COUNT 6
+#define MAX_RESULTS (FILL_COUNT * BENCH_COUNT)
+
+
+// One timed function at one fill.
+struct _Result {
+    char name[MAX_NAME];
+    int fill;
+    uint32_t length;
+    double ns;  // per call.
+};
+typedef struct _Result Result;
+
+
+// Everything a benchmark needs: one game, and somewhere to draw it.
+struct _Bench {
+    State state;
+    Arena arena;
+    Cell length;  // the length the snake is held at.
+    SDL_Surface* surfacep;
+    Atlas atlas;
+    uint32_t bgColor;
+    volatile uint32_t sink;  // keeps results from being optimized away.
+};
+typedef struct _Bench Bench;
+
+
+// Return the nanoseconds elapsed since an arbitrary point.
+uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Time MOVE_CALLS ticks of the snake following the cycle.  The snake is laid
+// out again, off the clock, as soon as it eats, so it stays at its length.
+// Returns the nanoseconds per tick, including the steering.
+double timeMove(Bench* benchp) {
+    State* statep = &(benchp->state);
+    Snake* snakep = playerSnake(statep);
+    uint64_t elapsedNs = 0;
+    uint64_t startNs = nowNs();
+    for (int call = 0; call < MOVE_CALLS; call++) {
+        steerOnCycle(statep);
+        moveSnake(statep);
+        if (statep->crashed || snakeLength(snakep) != benchp->length) {
+            elapsedNs += nowNs() - startNs;
+            layOnCycle(statep, benchp->length);
+            startNs = nowNs();
+        }
+    }
+    elapsedNs += nowNs() - startNs;
+    return (double)elapsedNs / MOVE_CALLS;
+}
+
+
+// Time putting down food.  Returns the nanoseconds per call.
+double timeRespawn(Bench* benchp) {
+    State* statep = &(benchp->state);
+    uint32_t placed = 0;
+    uint64_t startNs = nowNs();
+    for (int call = 0; call < RESPAWN_CALLS; call++) {
+        placed += respawnFood(statep);
+    }
+    uint64_t elapsedNs = nowNs() - startNs;
+    benchp->sink += placed;
+    return (double)elapsedNs / RESPAWN_CALLS;
+}
+
+
+// Time the collision check of the head with every body.  Returns the
+// nanoseconds per call.
+double timeCollide(Bench* benchp) {
+    State* statep = &(benchp->state);
+    Snake* snakep = playerSnake(statep);
+    uint32_t hits = 0;
+    uint64_t startNs = nowNs();
+    for (int call = 0; call < COLLIDE_CALLS; call++) {
+        hits += snakeCollidesWithSnake(statep, snakep);
+    }
+    uint64_t elapsedNs = nowNs() - startNs;
+    benchp->sink += hits;
+    return (double)elapsedNs / COLLIDE_CALLS;
+}
+
+
+// Time drawing the whole snake to the offscreen surface, as drawSnake() does
+// in the game.  Returns the nanoseconds per frame.
+double timeDraw(Bench* benchp) {
+    Snake* snakep = playerSnake(&(benchp->state));
+    uint64_t startNs = nowNs();
+    for (int call = 0; call < DRAW_CALLS; call++) {
+        atlasDrawSnake(&(benchp->atlas), &(benchp->state), snakep, benchp->surfacep, 0, 0);
+    }
+    uint64_t elapsedNs = nowNs() - startNs;
+    return (double)elapsedNs / DRAW_CALLS;
+}
+
+
+// Time drawing whole frames as the game repaints them in full: the
+// background, the snake and the food, either through SDL or by writing the
+// pixels directly.  Returns the nanoseconds per frame.
+double timeFrame(Bench* benchp, bool direct) {
+    State* statep = &(benchp->state);
+    Atlas* atlasp = &(benchp->atlas);
+    SDL_Surface* surfacep = benchp->surfacep;
+    SDL_Rect food = {statep->food.x * atlasCellSize(atlasp), statep->food.y * atlasCellSize(atlasp), 0, 0};
+    atlasp->direct = direct;
+    uint64_t startNs = nowNs();
+    for (int call = 0; call < DRAW_CALLS; call++) {
+        if (direct) {
+            SDL_LockSurface(surfacep);
+            rasterFill(surfacep, NULL, benchp->bgColor);
+        } else {
+            SDL_FillRect(surfacep, NULL, benchp->bgColor);
+        }
+        atlasDrawSnake(atlasp, statep, playerSnake(statep), surfacep, 0, 0);
+        atlasBlit(atlasp, TILE_FOOD, surfacep, food);
+        if (direct) {
+            SDL_UnlockSurface(surfacep);
+        }
+    }
+    uint64_t elapsedNs = nowNs() - startNs;
+    atlasp->direct = false;
+    return (double)elapsedNs / DRAW_CALLS;
+}
+
+
+// Time full frames drawn through SDL.
+double timeFrameSdl(Bench* benchp) {
+    return timeFrame(benchp, false);
+}
+
+
+// Time full frames drawn directly.
+double timeFrameDirect(Bench* benchp) {
+    return timeFrame(benchp, true);
+}
+
+
+// The timed functions, in the order they are reported.
+static const char* benchNames[BENCH_COUNT] = {"moveSnake", "respawnFood", "snakeCollidesWithSnake", "drawSnake",
+    "drawFrame", "drawFrameDirect"};
+static double (*const benchFunctions[BENCH_COUNT])(Bench*) = {timeMove, timeRespawn, timeCollide, timeDraw,
+    timeFrameSdl, timeFrameDirect};
+
+
+// Set up the game and the offscreen surface for a board.
+void benchInit(Bench* benchp, Coord gridWidth, Coord gridHeight) {
+    State* statep = &(benchp->state);
+    statep->gridWidth = gridWidth;
+    statep->gridHeight = gridHeight;
+    statep->snakeCount = 1;
+    arenaInit(&(benchp->arena), gameBytes(statep));
+    initGame(statep, &(benchp->arena));
+    seedRandom(statep, 1);
+
+    // the dummy driver only gives the atlas a display format to convert to.
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    int ret = SDL_Init(SDL_INIT_VIDEO);
+    assert(ret == 0);
+    SDL_Surface* displayp = SDL_SetVideoMode(1, 1, 16, SDL_SWSURFACE);
+    assert(displayp != NULL);
+    Coord side = gridWidth > gridHeight ? gridWidth : gridHeight;
+#ifdef CELL_SIZE
+    int cellSize = CELL_SIZE;
+    assert(side * cellSize <= MAX_SURFACE_SIDE);
+#else
+    int cellSize = MAX_SURFACE_SIDE / side < MAX_CELL_SIZE ? MAX_SURFACE_SIDE / side : MAX_CELL_SIZE;
+    assert(cellSize > 0);
+#endif
+    benchp->surfacep = SDL_CreateRGBSurface(SDL_SWSURFACE, gridWidth * cellSize, gridHeight * cellSize,
+        16, 0xF800, 0x07E0, 0x001F, 0);
+    assert(benchp->surfacep != NULL);
+    SDL_PixelFormat* formatp = benchp->surfacep->format;
+    benchp->bgColor = SDL_MapRGB(formatp, 0x00, 0x00, 0x00);
+    atlasInit(&(benchp->atlas), benchp->surfacep, cellSize, benchp->bgColor,
+        SDL_MapRGB(formatp, 0x00, 0xFF, 0x00), SDL_MapRGB(formatp, 0xFF, 0x00, 0x00));
+    benchp->sink = 0;
+}
+
+
+// Run every benchmark at every fill.  Returns the number of results.
+size_t runBenchmarks(Bench* benchp, Result* resultsp) {
+    State* statep = &(benchp->state);
+    Cell cellCount = (Cell)statep->gridWidth * statep->gridHeight;
+    size_t count = 0;
+    for (size_t i = 0; i < FILL_COUNT; i++) {
+        benchp->length = (Cell)((uint64_t)cellCount * fills[i] / 100);
+        if (benchp->length == 0) {
+            benchp->length = 1;
+        }
+        for (int b = 0; b < BENCH_COUNT; b++) {
+            double bestNs = 0;
+            for (int round = 0; round < REPEATS; round++) {
+                layOnCycle(statep, benchp->length);
+                double ns = benchFunctions[b](benchp);
+                if (round == 0 || ns < bestNs) {
+                    bestNs = ns;
+                }
+            }
+            Result* resultp = &(resultsp[count++]);
+            snprintf(resultp->name, MAX_NAME, "%s", benchNames[b]);
+            resultp->fill = fills[i];
+            resultp->length = benchp->length;
+            resultp->ns = bestNs;
+        }
+    }
+    return count;
+}
+
+
+// Write the results as JSON, one result to a line so that loadBaseline() can
+// read them back without a JSON parser.
+void printResults(State* statep, uint8_t cellSize, Result* resultsp, size_t count) {
+    printf("{\n");
+    printf("  \"board\": \"%ux%u\",\n", (unsigned)statep->gridWidth, (unsigned)statep->gridHeight);
+    printf("  \"cell_size\": %u,\n", cellSize);
+    printf("  \"repeats\": %d,\n", REPEATS);
+    printf("  \"results\": [\n");
+    for (size_t i = 0; i < count; i++) {
+        Result* resultp = &(resultsp[i]);
+        printf("    {\"name\": \"%s\", \"fill\": %d, \"length\": %u, \"ns\": %.2f}%s\n",
+            resultp->name, resultp->fill, resultp->length, resultp->ns, i + 1 < count ? "," : "");
+    }
+    printf("  ]\n");
+    printf("}\n");
+}
+
+
+// Read the results of an earlier run, as written by printResults().  Returns
+// the number of results, or -1 if the file can't be read or was run on
+// another board.
+int loadBaseline(const char* path, State* statep, Result* resultsp) {
+    FILE* filep = fopen(path, "r");
+    if (filep == NULL) {
+        return -1;
+    }
+    char line[256];
+    int count = 0;
+    bool sameBoard = false;
+    while (fgets(line, sizeof(line), filep) != NULL) {
+        unsigned width;
+        unsigned height;
+        if (sscanf(line, " \"board\": \"%ux%u\"", &width, &height) == 2) {
+            sameBoard = width == statep->gridWidth && height == statep->gridHeight;
+            continue;
+        }
+        Result* resultp = &(resultsp[count]);
+        if (count < (int)MAX_RESULTS && sscanf(line, " {\"name\": \"%31[^\"]\", \"fill\": %d, \"length\": %u, \"ns\": %lf",
+            resultp->name, &(resultp->fill), &(resultp->length), &(resultp->ns)) == 4) {
+            count++;
+        }
+    }
+    fclose(filep);
+    return sameBoard ? count : -1;
+}
+
+
+// Compare the results with the baseline, and report every one which is more
+// than thresholdPct percent slower.  Returns the number of regressions.
+int checkRegressions(Result* resultsp, size_t count, Result* baselinep, int baselineCount, double thresholdPct) {
+    int regressions = 0;
+    for (size_t i = 0; i < count; i++) {
+        Result* resultp = &(resultsp[i]);
+        for (int j = 0; j < baselineCount; j++) {
+            Result* basep = &(baselinep[j]);
+            if (strcmp(basep->name, resultp->name) != 0 || basep->fill != resultp->fill) {
+                continue;
+            }
+            double changePct = (resultp->ns / basep->ns - 1) * 100;
+            if (changePct > thresholdPct) {
+                fprintf(stderr, "regression: %s at %d%%: %.2f ns, baseline %.2f ns (+%.1f%%)\n",
+                    resultp->name, resultp->fill, resultp->ns, basep->ns, changePct);
+                regressions++;
+            }
+        }
+    }
+    return regressions;
+}
+
+
+// The microbenchmark entry point.  Exits with 1 if anything regressed by more
+// than the threshold (default 10%), and 2 if the baseline can't be used.
+// usage: snake-microbench [--board WxH] [--baseline FILE] [--threshold PCT]
+int main(int argc, char** argv) {
+    int width = 15;
+    int height = 10;
+    const char* baselinePath = NULL;
+    double thresholdPct = 10;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            int ret = sscanf(argv[++i], "%dx%d", &width, &height);
+            assert(ret == 2);
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            thresholdPct = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--board WxH] [--baseline FILE] [--threshold PCT]\n", argv[0]);
+            return 2;
+        }
+    }
+    // the cycle needs an even height.
+    assert(width >= 2 && width <= MAX_GRID_SIDE);
+    assert(height >= 2 && height <= MAX_GRID_SIDE && height % 2 == 0);
+
+    Bench bench;
+    benchInit(&bench, width, height);
+    Result results[MAX_RESULTS];
+    size_t count = runBenchmarks(&bench, results);
+    printResults(&(bench.state), bench.atlas.cellSize, results, count);
+
+    int status = 0;
+    if (baselinePath != NULL) {
+        Result baseline[MAX_RESULTS];
+        int baselineCount = loadBaseline(baselinePath, &(bench.state), baseline);
+        if (baselineCount < 0) {
+            fprintf(stderr, "can't use baseline %s: unreadable, or run on another board\n", baselinePath);
+            status = 2;
+        } else if (checkRegressions(results, count, baseline, baselineCount, thresholdPct) > 0) {
+            status = 1;
+        }
+    }
+    SDL_FreeSurface(bench.surfacep);
+    SDL_Quit();
+    arenaFree(&(bench.arena));
+    return status;
+}
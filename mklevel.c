@@ -0,0 +1,95 @@
+// Level maker: turns a text picture of a level into a level file.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// The picture has one line per row of the board: '#' is a wall, and
+// anything else is open floor.  The board is as wide as the longest line,
+// and short lines are open to the right.  The text is only ever read here:
+// the game maps the result as it is.
+
+#include "level.h"
+
+#include <stdint.h>  // uint8_t
+#include <stdio.h>  // fopen, fgets, printf
+#include <stdlib.h>  // calloc, free
+#include <string.h>  // strcmp, strcspn, strlen
+
+#define MAX_LEVEL_SIDE 255  // the header keeps each side in a byte.
+#define MAX_LINE (MAX_LEVEL_SIDE + 2)  // a row, its newline and the terminator.
+
+
+// The level maker entry point.
+// usage: snake-mklevel [--wrap] picture.txt level.lvl
+int main(int argc, char** argv) {
+    int first = 1;
+    bool wrap = false;
+    if (argc > 1 && strcmp(argv[1], "--wrap") == 0) {
+        wrap = true;
+        first = 2;
+    }
+    if (argc != first + 2) {
+        fprintf(stderr, "usage: snake-mklevel [--wrap] picture.txt level.lvl\n");
+        return 1;
+    }
+    FILE* filep = fopen(argv[first], "r");
+    if (filep == NULL) {
+        fprintf(stderr, "can't read %s\n", argv[first]);
+        return 1;
+    }
+
+    // the rows, as read.
+    static char rows[MAX_LEVEL_SIDE][MAX_LINE];
+    size_t gridWidth = 0;
+    size_t gridHeight = 0;
+    char line[MAX_LINE];
+    while (fgets(line, sizeof(line), filep) != NULL) {
+        size_t length = strcspn(line, "\r\n");
+        if (length == strlen(line) && feof(filep) == false) {
+            fprintf(stderr, "row %zu is longer than %d cells\n", gridHeight + 1, MAX_LEVEL_SIDE);
+            return 1;
+        }
+        if (gridHeight == MAX_LEVEL_SIDE) {
+            fprintf(stderr, "more than %d rows\n", MAX_LEVEL_SIDE);
+            return 1;
+        }
+        line[length] = '\0';
+        strcpy(rows[gridHeight++], line);
+        if (length > gridWidth) {
+            gridWidth = length;
+        }
+    }
+    fclose(filep);
+    if (gridWidth == 0 || gridHeight == 0) {
+        fprintf(stderr, "%s is empty\n", argv[first]);
+        return 1;
+    }
+
+    uint8_t* wallsp = calloc((gridWidth * gridHeight + 7) / 8, 1);
+    assert(wallsp != NULL);
+    size_t wallCount = 0;
+    for (size_t y = 0; y < gridHeight; y++) {
+        for (size_t x = 0; x < strlen(rows[y]); x++) {
+            if (rows[y][x] == '#') {
+                size_t i = y * gridWidth + x;
+                wallsp[i >> 3] |= (uint8_t)(1 << (i & 7));
+                wallCount++;
+            }
+        }
+    }
+    if (wallCount + 2 > gridWidth * gridHeight) {
+        fprintf(stderr, "no room left for a snake and food\n");
+        return 1;
+    }
+    if (levelSave(argv[first + 1], gridWidth, gridHeight, wrap, wallsp) == false) {
+        fprintf(stderr, "can't write %s\n", argv[first + 1]);
+        return 1;
+    }
+    printf("%zux%zu, %zu walls%s\n", gridWidth, gridHeight, wallCount, wrap ? ", wrapping round" : "");
+    free(wallsp);
+    return 0;
+}
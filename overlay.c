@@ -0,0 +1,99 @@
+// A tiny on-screen text renderer, for debug overlays.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "overlay.h"
+
+#include <stdio.h>  // snprintf
+
+
+// A 3x5 pixel font.  Each glyph is five rows of three bits, top row first,
+// with the leftmost pixel in the high bit of each row.  Lower case letters
+// are drawn as upper case, and anything missing as a space.
+static const uint16_t glyphs[128] = {
+    ['0'] = 0x7B6F, ['1'] = 0x2C97, ['2'] = 0x73E7, ['3'] = 0x73CF, ['4'] = 0x5BC9, ['5'] = 0x79CF,
+    ['6'] = 0x79EF, ['7'] = 0x7249, ['8'] = 0x7BEF, ['9'] = 0x7BCF, ['A'] = 0x2BED, ['B'] = 0x6BAE,
+    ['C'] = 0x3923, ['D'] = 0x6B6E, ['E'] = 0x79A7, ['F'] = 0x79A4, ['G'] = 0x396B, ['H'] = 0x5BED,
+    ['I'] = 0x7497, ['J'] = 0x126A, ['K'] = 0x5BAD, ['L'] = 0x4927, ['M'] = 0x5FED, ['N'] = 0x6B6D,
+    ['O'] = 0x2B6A, ['P'] = 0x6BA4, ['Q'] = 0x2B73, ['R'] = 0x6BAD, ['S'] = 0x388E, ['T'] = 0x7492,
+    ['U'] = 0x5B6F, ['V'] = 0x5B6A, ['W'] = 0x5BFD, ['X'] = 0x5AAD, ['Y'] = 0x5A92, ['Z'] = 0x72A7,
+    ['.'] = 0x0002, ['/'] = 0x12A4, ['-'] = 0x01C0, [':'] = 0x0410, ['%'] = 0x52A5,
+};
+
+
+// Draw one line of text with its top left corner at (x, y).  Returns the
+// width drawn, in pixels.
+int drawText(SDL_Surface* surfacep, int x, int y, const char* textp, uint32_t color) {
+    int startX = x;
+    for (; *textp != '\0'; textp++) {
+        unsigned char c = *textp;
+        if (c >= 'a' && c <= 'z') {
+            c -= 'a' - 'A';
+        }
+        uint16_t glyph = c < 128 ? glyphs[c] : 0;
+        for (int row = 0; row < FONT_HEIGHT; row++) {
+            int bits = (glyph >> (3 * (FONT_HEIGHT - 1 - row))) & 7;
+            // fill each run of set pixels with a single rectangle.
+            int column = 0;
+            while (column < 3) {
+                if ((bits & (4 >> column)) == 0) {
+                    column++;
+                    continue;
+                }
+                int runStart = column;
+                while (column < 3 && (bits & (4 >> column))) {
+                    column++;
+                }
+                SDL_Rect rect = {x + runStart, y + row, column - runStart, 1};
+                SDL_FillRect(surfacep, &rect, color);
+            }
+        }
+        x += FONT_ADVANCE;
+    }
+    return x - startX;
+}
+
+
+// Draw the timing overlay in the top left corner: min, average and 99th
+// percentile of every phase and of the interval between frames, in
+// microseconds, then the late frames, dropped ticks and largest stall.
+// Returns the area covered.
+SDL_Rect drawTimingOverlay(SDL_Surface* surfacep, Timing* timingp, Pacing* pacingp, uint32_t fgColor,
+    uint32_t bgColor) {
+    SDL_Rect box = {0, 0, OVERLAY_WIDTH, (PHASE_COUNT + 3) * FONT_LINE + 2};
+    SDL_FillRect(surfacep, &box, bgColor);
+
+    char line[32];
+    int y = 1;
+    snprintf(line, sizeof(line), "%-5s %6s %6s %6s", "US", "MIN", "AVG", "P99");
+    drawText(surfacep, 1, y, line, fgColor);
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        y += FONT_LINE;
+        Histogram* histogramp = &(timingp->phases[i]);
+        uint64_t count = histogramp->count;
+        unsigned minUs = count ? histogramp->minNs / 1000 : 0;
+        unsigned avgUs = count ? histogramp->totalNs / count / 1000 : 0;
+        unsigned p99Us = histogramPercentile(histogramp, 0.99) / 1000;
+        snprintf(line, sizeof(line), "%-5s %6u %6u %6u", phaseNames[i], minUs, avgUs, p99Us);
+        drawText(surfacep, 1, y, line, fgColor);
+    }
+
+    Histogram* intervalsp = &(pacingp->intervals);
+    uint64_t count = intervalsp->count;
+    y += FONT_LINE;
+    snprintf(line, sizeof(line), "%-5s %6u %6u %6u", "frame", (unsigned)(count ? intervalsp->minNs / 1000 : 0),
+        (unsigned)(count ? intervalsp->totalNs / count / 1000 : 0),
+        (unsigned)(histogramPercentile(intervalsp, 0.99) / 1000));
+    drawText(surfacep, 1, y, line, fgColor);
+    // counts the width of the box can't hold are cut short.
+    y += FONT_LINE;
+    snprintf(line, OVERLAY_WIDTH / FONT_ADVANCE + 1, "late %u drop %u max %ums", pacingp->lateFrames,
+        pacingp->droppedTicks, (unsigned)(intervalsp->maxNs / 1000000));
+    drawText(surfacep, 1, y, line, fgColor);
+    return box;
+}
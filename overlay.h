@@ -0,0 +1,40 @@
+// A tiny on-screen text renderer, for debug overlays.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#ifndef OVERLAY_H
+#define OVERLAY_H
+
+#include "timing.h"
+
+#include <stdint.h>  // uint32_t
+
+#ifdef __APPLE__
+#include <SDL.h>
+#else
+#include <SDL/SDL.h>
+#endif
+
+#define FONT_HEIGHT 5
+#define FONT_ADVANCE 4  // glyph width plus one pixel of spacing.
+#define FONT_LINE 6  // glyph height plus one pixel of spacing.
+#define OVERLAY_WIDTH (26 * FONT_ADVANCE + 2)
+
+
+// Draw one line of text with its top left corner at (x, y).  Returns the
+// width drawn, in pixels.
+int drawText(SDL_Surface* surfacep, int x, int y, const char* textp, uint32_t color);
+
+// Draw the timing overlay in the top left corner: min, average and 99th
+// percentile of every phase and of the interval between frames, in
+// microseconds, then the late frames, dropped ticks and largest stall.
+// Returns the area covered.
+SDL_Rect drawTimingOverlay(SDL_Surface* surfacep, Timing* timingp, Pacing* pacingp, uint32_t fgColor,
+    uint32_t bgColor);
+
+#endif
@@ -0,0 +1,153 @@
+// Direct pixel drawing: fills and copies written straight into 16bpp
+// surfaces, without going through SDL's blitters.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "raster.h"
+
+#include <stddef.h>  // size_t
+#include <string.h>  // memcpy
+
+#define CACHE_LINE 32  // bytes, on the RS-90's XBurst core.
+
+// Two pixels, written as one.  may_alias, since the same memory is also
+// written one pixel at a time.
+typedef uint32_t __attribute__((may_alias)) PixelPair;
+
+
+// Can the functions below draw on a surface?  It must be 16bpp.
+bool rasterSupports(SDL_Surface* surfacep) {
+    return surfacep->format->BytesPerPixel == 2;
+}
+
+
+// Fill count pixels from p with a color, repeated in both halves of pair.
+static void fillSpan(uint16_t* p, size_t count, uint32_t pair) {
+    if (count == 0) {
+        return;
+    }
+    // a lone pixel first, if that leaves the rest word aligned.
+    if (((uintptr_t)p & 2) != 0) {
+        *p++ = pair;
+        count--;
+    }
+    PixelPair* wordp = (PixelPair*)p;
+    size_t words = count / 2;
+#ifdef __mips__
+    // pref 30 (prepare for store) claims a cache line without reading it
+    // from memory, which is only safe when all of the line is overwritten.
+    while (words > 0 && ((uintptr_t)wordp & (CACHE_LINE - 1)) != 0) {
+        *wordp++ = pair;
+        words--;
+    }
+    for (; words >= CACHE_LINE / 4; words -= CACHE_LINE / 4) {
+        __asm__ volatile("pref 30, 0(%0)" : : "r"(wordp) : "memory");
+        wordp[0] = pair;
+        wordp[1] = pair;
+        wordp[2] = pair;
+        wordp[3] = pair;
+        wordp[4] = pair;
+        wordp[5] = pair;
+        wordp[6] = pair;
+        wordp[7] = pair;
+        wordp += CACHE_LINE / 4;
+    }
+#endif
+    for (; words >= 4; words -= 4) {
+        wordp[0] = pair;
+        wordp[1] = pair;
+        wordp[2] = pair;
+        wordp[3] = pair;
+        wordp += 4;
+    }
+    for (; words > 0; words--) {
+        *wordp++ = pair;
+    }
+    if ((count & 1) != 0) {
+        *(uint16_t*)wordp = pair;
+    }
+}
+
+
+// Clip a rectangle at (x, y) to a surface.  Returns false if nothing is
+// left of it.  The offsets of the part left from the original are added to
+// *dxp and *dyp.
+static bool clip(SDL_Surface* surfacep, int* xp, int* yp, int* wp, int* hp, int* dxp, int* dyp) {
+    if (*xp < 0) {
+        *wp += *xp;
+        *dxp -= *xp;
+        *xp = 0;
+    }
+    if (*yp < 0) {
+        *hp += *yp;
+        *dyp -= *yp;
+        *yp = 0;
+    }
+    if (*xp + *wp > surfacep->w) {
+        *wp = surfacep->w - *xp;
+    }
+    if (*yp + *hp > surfacep->h) {
+        *hp = surfacep->h - *yp;
+    }
+    return *wp > 0 && *hp > 0;
+}
+
+
+// Fill a rectangle of a locked surface with a mapped color, clipped to the
+// surface.  A NULL rectp fills the whole surface, as with SDL_FillRect().
+void rasterFill(SDL_Surface* surfacep, SDL_Rect* rectp, uint32_t color) {
+    int x = 0;
+    int y = 0;
+    int w = surfacep->w;
+    int h = surfacep->h;
+    if (rectp != NULL) {
+        int dx = 0;
+        int dy = 0;
+        x = rectp->x;
+        y = rectp->y;
+        w = rectp->w;
+        h = rectp->h;
+        if (clip(surfacep, &x, &y, &w, &h, &dx, &dy) == false) {
+            return;
+        }
+    }
+    uint32_t pair = (color & 0xFFFF) | (color << 16);
+    uint8_t* rowp = (uint8_t*)surfacep->pixels + (size_t)y * surfacep->pitch + x * 2;
+    if (x == 0 && w == surfacep->w && surfacep->pitch == w * 2) {
+        // whole rows with no padding: one span.
+        fillSpan((uint16_t*)rowp, (size_t)w * h, pair);
+        return;
+    }
+    for (int row = 0; row < h; row++) {
+        fillSpan((uint16_t*)rowp, w, pair);
+        rowp += surfacep->pitch;
+    }
+}
+
+
+// Copy a rectangle of one surface to (x, y) on a locked surface of the same
+// format, clipped to the destination.  The source rectangle must lie within
+// the source, which must not need locking.
+void rasterCopy(SDL_Surface* sourcep, SDL_Rect source, SDL_Surface* destp, int x, int y) {
+    int w = source.w;
+    int h = source.h;
+    int dx = 0;
+    int dy = 0;
+    if (clip(destp, &x, &y, &w, &h, &dx, &dy) == false) {
+        return;
+    }
+    const uint8_t* fromp = (const uint8_t*)sourcep->pixels + (size_t)(source.y + dy) * sourcep->pitch +
+        (source.x + dx) * 2;
+    uint8_t* top = (uint8_t*)destp->pixels + (size_t)y * destp->pitch + x * 2;
+    // a tile row is a few words: memcpy moves them a word at a time.
+    for (int row = 0; row < h; row++) {
+        memcpy(top, fromp, (size_t)w * 2);
+        fromp += sourcep->pitch;
+        top += destp->pitch;
+    }
+}
@@ -0,0 +1,43 @@
+// Direct pixel drawing: fills and copies written straight into 16bpp
+// surfaces, without going through SDL's blitters.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// On a small board most SDL_FillRect() and SDL_BlitSurface() calls only
+// cover a cell or two, and checking, clipping and locking them costs more
+// than moving the pixels.  These functions do none of that for each call:
+// the caller locks the screen once per frame, and every span is written as
+// pairs of pixels, one 32 bit store each.  On MIPS, whole cache lines of a
+// fill are claimed without being read first.
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdint.h>  // uint32_t
+#include <stdbool.h>  // bool
+
+#ifdef __APPLE__
+#include <SDL.h>
+#else
+#include <SDL/SDL.h>
+#endif
+
+
+// Can the functions below draw on a surface?  It must be 16bpp.
+bool rasterSupports(SDL_Surface* surfacep);
+
+// Fill a rectangle of a locked surface with a mapped color, clipped to the
+// surface.  A NULL rectp fills the whole surface, as with SDL_FillRect().
+void rasterFill(SDL_Surface* surfacep, SDL_Rect* rectp, uint32_t color);
+
+// Copy a rectangle of one surface to (x, y) on a locked surface of the same
+// format, clipped to the destination.  The source rectangle must lie within
+// the source, which must not need locking.
+void rasterCopy(SDL_Surface* sourcep, SDL_Rect source, SDL_Surface* destp, int x, int y);
+
+#endif
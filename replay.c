@@ -0,0 +1,261 @@
+// Recording and replaying the inputs of a snake session.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "replay.h"
+
+#include <string.h>  // memcpy, memcmp
+#include <errno.h>  // errno, EINTR
+#include <fcntl.h>  // open
+#include <unistd.h>  // write, pwrite, close
+#include <sys/mman.h>  // mmap, madvise, munmap
+#include <sys/stat.h>  // fstat
+
+
+// Store a 32 bit value, little-endian.
+static void putU32(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+
+// Load a 32 bit value, little-endian.
+static uint32_t getU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+// Write out the buffered entries.  Returns false if they can't be written.
+static bool recorderFlush(Recorder* recorderp) {
+    size_t done = 0;
+    while (done < recorderp->used) {
+        ssize_t n = write(recorderp->fd, recorderp->buf + done, recorderp->used - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            recorderp->used = 0;
+            return false;
+        }
+        done += n;
+    }
+    recorderp->used = 0;
+    return true;
+}
+
+
+// Start recording into a new replay file.  statep must be freshly seeded with
+// seed.  Returns false if the file can't be created.
+bool recorderOpen(Recorder* recorderp, const char* path, State* statep, uint32_t seed) {
+    recorderp->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (recorderp->fd < 0) {
+        return false;
+    }
+    uint8_t* p = recorderp->buf;
+    memcpy(p, "SNKR", 4);
+    p[4] = REPLAY_VERSION;
+    p[5] = statep->gridWidth;
+    p[6] = statep->gridHeight;
+    p[7] = 0;
+    putU32(p + 8, seed);
+    putU32(p + 12, REPLAY_NO_END);
+    recorderp->used = REPLAY_HEADER_SIZE;
+    recorderp->lastTick = statep->tickCount;
+    return true;
+}
+
+
+// Log an accepted direction change, applied before the move of tick.
+// Returns false if the file can't be written: it is then closed, cut short
+// where it failed, and nothing more is recorded.
+bool recordTurn(Recorder* recorderp, uint32_t tick, uint8_t direction) {
+    if (recorderp->fd < 0) {
+        return false;
+    }
+    // an entry is at most 1 + 5 bytes.
+    if (recorderp->used + 6 > REPLAY_BUF_SIZE && recorderFlush(recorderp) == false) {
+        close(recorderp->fd);
+        recorderp->fd = -1;
+        return false;
+    }
+    uint32_t delta = tick - recorderp->lastTick;
+    recorderp->lastTick = tick;
+
+    uint8_t* p = recorderp->buf + recorderp->used;
+    uint8_t dirBits = (direction - 1) << 6;
+    if (delta < 63) {
+        *p++ = dirBits | delta;
+    } else {
+        *p++ = dirBits | 63;
+        delta -= 63;
+        while (delta >= 0x80) {
+            *p++ = (delta & 0x7F) | 0x80;
+            delta >>= 7;
+        }
+        *p++ = delta;
+    }
+    recorderp->used = p - recorderp->buf;
+    return true;
+}
+
+
+// Flush the remaining entries, patch in the end tick and close the file.
+// Returns false if they can't be written, or were not all written before.
+bool recorderClose(Recorder* recorderp, uint32_t endTick) {
+    if (recorderp->fd < 0) {
+        return false;
+    }
+    bool ok = recorderFlush(recorderp);
+    uint8_t end[4];
+    putU32(end, endTick);
+    // without the end tick, the replay still plays as one cut short.
+    ok = ok && pwrite(recorderp->fd, end, sizeof(end), 12) == sizeof(end);
+    ok = close(recorderp->fd) == 0 && ok;
+    recorderp->fd = -1;
+    return ok;
+}
+
+
+// Return the next byte of the replay.  Returns -1 at the end of the file.
+static int playerByte(Player* playerp) {
+    if (playerp->pos == playerp->size) {
+        return -1;
+    }
+    // a whole window behind the one being read: drop it.  The window is a
+    // multiple of the page size, so this keeps to page boundaries.
+    if (playerp->pos - playerp->released >= 2 * REPLAY_WINDOW) {
+        madvise((void*)(playerp->datap + playerp->released), REPLAY_WINDOW, MADV_DONTNEED);
+        playerp->released += REPLAY_WINDOW;
+    }
+    return playerp->datap[playerp->pos++];
+}
+
+
+// Decode the next entry into nextTick and nextDirection.  An entry with a
+// delta too large for 32 bits marks the replay corrupt.
+static void playerAdvance(Player* playerp) {
+    int b = playerByte(playerp);
+    if (b < 0) {
+        playerp->hasPending = false;
+        return;
+    }
+    uint32_t delta = b & 63;
+    if (delta == 63) {
+        uint32_t extra = 0;
+        int shift = 0;
+        int c;
+        do {
+            c = playerByte(playerp);
+            if (c < 0) {
+                // truncated entry.
+                playerp->hasPending = false;
+                return;
+            }
+            if (shift >= 32) {
+                playerp->hasPending = false;
+                playerp->corrupt = true;
+                return;
+            }
+            extra |= (uint32_t)(c & 0x7F) << shift;
+            shift += 7;
+        } while (c & 0x80);
+        delta += extra;
+    }
+    playerp->nextTick += delta;
+    playerp->nextDirection = (b >> 6) + 1;
+    playerp->hasPending = true;
+}
+
+
+// Open a replay file and read its header.  Returns false if the file can't
+// be read or isn't a replay.
+bool playerOpen(Player* playerp, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < REPLAY_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+    void* datap = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (datap == MAP_FAILED) {
+        return false;
+    }
+    const uint8_t* h = datap;
+    if (memcmp(h, "SNKR", 4) != 0 || h[4] != REPLAY_VERSION) {
+        munmap(datap, st.st_size);
+        return false;
+    }
+    // read front to back, once: let the kernel read ahead.
+    madvise(datap, st.st_size, MADV_SEQUENTIAL);
+    playerp->datap = datap;
+    playerp->size = st.st_size;
+    playerp->header.gridWidth = h[5];
+    playerp->header.gridHeight = h[6];
+    playerp->header.seed = getU32(h + 8);
+    playerp->header.endTick = getU32(h + 12);
+    playerRewind(playerp);
+    return true;
+}
+
+
+// Close a replay file.
+void playerClose(Player* playerp) {
+    munmap((void*)playerp->datap, playerp->size);
+    playerp->datap = NULL;
+}
+
+
+// Go back to the start of a replay.  The state must be seeded with the
+// header's seed and restarted again, from a tick count of 0, to play it.
+void playerRewind(Player* playerp) {
+    // the end of the last run is still paged in.
+    madvise((void*)playerp->datap, playerp->size, MADV_DONTNEED);
+    playerp->pos = REPLAY_HEADER_SIZE;
+    playerp->released = 0;
+    playerp->nextTick = 0;
+    playerp->corrupt = false;
+    playerAdvance(playerp);
+}
+
+
+// Simulate one tick of the replay: restart if crashed, apply the logged
+// direction changes and move.  Returns false, without moving, once the
+// replay is over, or once it turns out to be corrupt: an entry for a tick
+// already gone by, or a turn the snake wouldn't take.
+bool replayTick(Player* playerp, State* statep) {
+    if (playerp->corrupt || statep->tickCount == playerp->header.endTick) {
+        return false;
+    }
+    if (statep->crashed) {
+        // without an end tick, stop at the first crash after the last entry.
+        if (playerp->header.endTick == REPLAY_NO_END && playerp->hasPending == false) {
+            return false;
+        }
+        restart(statep);
+    }
+    if (playerp->hasPending && playerp->nextTick < statep->tickCount) {
+        playerp->corrupt = true;
+        return false;
+    }
+    while (playerp->hasPending && playerp->nextTick == statep->tickCount) {
+        // a recording only logs the turns which were taken.
+        if (turnSnake(playerSnake(statep), playerp->nextDirection) == false) {
+            playerp->corrupt = true;
+            return false;
+        }
+        playerAdvance(playerp);
+    }
+    moveSnake(statep);
+    return true;
+}
@@ -0,0 +1,110 @@
+// Recording and replaying the inputs of a snake session.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// A replay file is a 16 byte header followed by one entry per accepted
+// direction change.  All multi-byte fields are little-endian.
+//
+//   header: "SNKR", version, gridWidth, gridHeight, 0, seed (4), endTick (4)
+//   entry:  (direction - 1) << 6 | tickDelta, for tickDelta < 63
+//           (direction - 1) << 6 | 63, then LEB128 (tickDelta - 63)
+//
+// tickDelta is the number of ticks since the previous entry (or since tick
+// 0).  The direction is applied just before the move of that tick.  Restarts
+// are not logged: the replay restarts as soon as the snake crashes, which
+// draws the same numbers from the generator as a live restart.  endTick is
+// patched in when the recording is closed, and stays 0xFFFFFFFF if the
+// recording was cut short.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "engine.h"
+
+#include <stdint.h>  // uint8_t
+#include <stdbool.h>  // bool
+#include <stddef.h>  // size_t
+
+#define REPLAY_VERSION 1
+#define REPLAY_HEADER_SIZE 16
+#define REPLAY_BUF_SIZE 4096
+#define REPLAY_NO_END 0xFFFFFFFF
+#define REPLAY_WINDOW 65536  // how much of a mapped replay is kept paged in.
+
+
+// The header of a replay file.
+struct _ReplayHeader {
+    uint8_t gridWidth;
+    uint8_t gridHeight;
+    uint32_t seed;
+    uint32_t endTick;
+};
+typedef struct _ReplayHeader ReplayHeader;
+
+
+// Writes a replay file.  Entries are collected in a buffer and written out
+// in large batches.
+struct _Recorder {
+    int fd;
+    uint32_t lastTick;
+    size_t used;
+    uint8_t buf[REPLAY_BUF_SIZE];
+};
+typedef struct _Recorder Recorder;
+
+
+// Reads a replay file back, straight out of a read-only mapping.  The pages
+// already played are handed back as it goes, so however long the replay,
+// no more than two windows of it are ever resident.
+struct _Player {
+    const uint8_t* datap;  // the whole file, header included.
+    size_t size;
+    size_t pos;  // the next byte to decode.
+    size_t released;  // the bytes before this have been handed back.
+    ReplayHeader header;
+
+    // the next entry to apply, if hasPending.
+    bool hasPending;
+    bool corrupt;  // the replay went out of step with the game.
+    uint32_t nextTick;
+    uint8_t nextDirection;
+};
+typedef struct _Player Player;
+
+
+// Start recording into a new replay file.  statep must be freshly seeded with
+// seed.  Returns false if the file can't be created.
+bool recorderOpen(Recorder* recorderp, const char* path, State* statep, uint32_t seed);
+
+// Log an accepted direction change, applied before the move of tick.
+// Returns false if the file can't be written: it is then closed, cut short
+// where it failed, and nothing more is recorded.
+bool recordTurn(Recorder* recorderp, uint32_t tick, uint8_t direction);
+
+// Flush the remaining entries, patch in the end tick and close the file.
+// Returns false if they can't be written, or were not all written before.
+bool recorderClose(Recorder* recorderp, uint32_t endTick);
+
+// Open a replay file and read its header.  Returns false if the file can't
+// be read or isn't a replay.
+bool playerOpen(Player* playerp, const char* path);
+
+// Close a replay file.
+void playerClose(Player* playerp);
+
+// Go back to the start of a replay.  The state must be seeded with the
+// header's seed and restarted again, from a tick count of 0, to play it.
+void playerRewind(Player* playerp);
+
+// Simulate one tick of the replay: restart if crashed, apply the logged
+// direction changes and move.  Returns false, without moving, once the
+// replay is over, or once it turns out to be corrupt (corrupt is then set):
+// an entry for a tick already gone by, or a turn the snake wouldn't take.
+bool replayTick(Player* playerp, State* statep);
+
+#endif
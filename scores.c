@@ -0,0 +1,127 @@
+// The high score and lifetime stats, kept across runs.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "scores.h"
+
+#include <stddef.h>  // size_t
+#include <stdio.h>  // snprintf, rename
+#include <string.h>  // memcpy, memcmp, memset
+#include <fcntl.h>  // open
+#include <unistd.h>  // read, write, fsync, close, unlink
+
+#define CHECKSUM_OFFSET 24
+
+
+// Store a 32 bit value, little-endian.
+static void putU32(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+
+// Load a 32 bit value, little-endian.
+static uint32_t getU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+// Return the FNV-1a hash of a buffer.
+static uint32_t checksum(const uint8_t* bufp, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bufp[i]) * 16777619u;
+    }
+    return hash;
+}
+
+
+// Read the stats from a file.  Returns false if there is no valid file; the
+// stats then start from zero.
+bool scoresLoad(Scores* scoresp, const char* path) {
+    memset(scoresp, 0, sizeof(*scoresp));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    uint8_t buf[SCORES_FILE_SIZE + 1];
+    ssize_t size = read(fd, buf, sizeof(buf));
+    close(fd);
+    if (size != SCORES_FILE_SIZE || memcmp(buf, "SNKH", 4) != 0 || buf[4] != SCORES_VERSION ||
+        getU32(buf + CHECKSUM_OFFSET) != checksum(buf, CHECKSUM_OFFSET)) {
+        return false;
+    }
+    scoresp->gamesPlayed = getU32(buf + 8);
+    scoresp->bestLength = getU32(buf + 12);
+    scoresp->totalTicks = getU32(buf + 16) | (uint64_t)getU32(buf + 20) << 32;
+    return true;
+}
+
+
+// Count ticks played.
+void scoresAddTicks(Scores* scoresp, uint32_t ticks) {
+    if (ticks > 0) {
+        scoresp->totalTicks += ticks;
+        scoresp->dirty = true;
+    }
+}
+
+
+// Count a game played to the end, with the snake at length.  Returns true if
+// that is a new best.
+bool scoresGameOver(Scores* scoresp, uint32_t length) {
+    scoresp->gamesPlayed++;
+    scoresp->dirty = true;
+    if (length <= scoresp->bestLength) {
+        return false;
+    }
+    scoresp->bestLength = length;
+    return true;
+}
+
+
+// Write the stats back to the file, if they have changed.  Returns false if
+// they can't be written, in which case they stay dirty.
+bool scoresFlush(Scores* scoresp, const char* path) {
+    if (scoresp->dirty == false) {
+        return true;
+    }
+    uint8_t buf[SCORES_FILE_SIZE];
+    memcpy(buf, "SNKH", 4);
+    buf[4] = SCORES_VERSION;
+    buf[5] = 0;
+    buf[6] = 0;
+    buf[7] = 0;
+    putU32(buf + 8, scoresp->gamesPlayed);
+    putU32(buf + 12, scoresp->bestLength);
+    putU32(buf + 16, scoresp->totalTicks);
+    putU32(buf + 20, scoresp->totalTicks >> 32);
+    putU32(buf + CHECKSUM_OFFSET, checksum(buf, CHECKSUM_OFFSET));
+
+    char tmpPath[256];
+    int len = snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    if (len < 0 || (size_t)len >= sizeof(tmpPath)) {
+        return false;
+    }
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    // one write and one fsync per flush: the data must be on the card before
+    // the rename makes it the scores file.
+    bool ok = write(fd, buf, sizeof(buf)) == sizeof(buf) && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (ok == false || rename(tmpPath, path) != 0) {
+        unlink(tmpPath);
+        return false;
+    }
+    scoresp->dirty = false;
+    return true;
+}
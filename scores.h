@@ -0,0 +1,60 @@
+// The high score and lifetime stats, kept across runs.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// The stats are read once at startup and only ever changed in memory after
+// that.  They go back to storage at most once per game over, while the game
+// waits for a key with nothing on the screen changing, and once on exit: an
+// SD card write never lands in the middle of a live frame.
+//
+// A scores file is 28 bytes.  All multi-byte fields are little-endian.
+//
+//   "SNKH", version, 0, 0, 0, gamesPlayed (4), bestLength (4),
+//   totalTicks (8), checksum (4)
+//
+// The checksum is FNV-1a over the 24 bytes before it.  The file is written
+// under a temporary name and renamed over the old one, so a power cut leaves
+// either the old stats or the new ones; a file which fails the checksum
+// anyway (a card which doesn't keep writes in order) counts as no file.
+
+#ifndef SCORES_H
+#define SCORES_H
+
+#include <stdint.h>  // uint32_t
+#include <stdbool.h>  // bool
+
+#define SCORES_VERSION 1
+#define SCORES_FILE_SIZE 28
+
+
+// The lifetime stats.
+struct _Scores {
+    uint32_t gamesPlayed;  // games played to the end.
+    uint32_t bestLength;  // the longest snake of any of them.
+    uint64_t totalTicks;  // ticks played, games in progress at exit included.
+    bool dirty;  // changed since the file was read or written.
+};
+typedef struct _Scores Scores;
+
+
+// Read the stats from a file.  Returns false if there is no valid file; the
+// stats then start from zero.
+bool scoresLoad(Scores* scoresp, const char* path);
+
+// Count ticks played.
+void scoresAddTicks(Scores* scoresp, uint32_t ticks);
+
+// Count a game played to the end, with the snake at length.  Returns true if
+// that is a new best.
+bool scoresGameOver(Scores* scoresp, uint32_t length);
+
+// Write the stats back to the file, if they have changed.  Returns false if
+// they can't be written, in which case they stay dirty.
+bool scoresFlush(Scores* scoresp, const char* path);
+
+#endif
@@ -7,13 +7,28 @@
 // - camelCase for identifiers.
 // - 'p' suffix used for pointers.
 
+// This file is the SDL front end.  The game rules live in engine.c.
+
+#include "engine.h"
+#include "replay.h"
+#include "autopilot.h"
+#include "timing.h"
+#include "overlay.h"
+#include "tiles.h"
+#include "raster.h"
+#include "snapshot.h"
+#include "scores.h"
+#include "telemetry.h"
+#include "level.h"
+
 #include <stdint.h>  // uint8_t
 #include <assert.h>  // assert
 #include <stdbool.h>  // true
-#include <stdlib.h>  // exit, srand, rand
+#include <stdlib.h>  // exit, strtoul
+#include <string.h>  // strcmp, memset
+#include <stdio.h>  // printf, fprintf
 #include <time.h>  // time
-
-#define unreachable assert(false);exit(99);
+#include <unistd.h>  // unlink
 
 #ifdef __APPLE__
 #include <SDL.h>
@@ -21,475 +36,1203 @@
 #include <SDL/SDL.h>
 #endif
 
+#define TURN_QUEUE_SIZE 3  // turns which can be read ahead of their tick.
+#define MAX_TICKS_PER_FRAME 3  // beyond this, fall behind rather than stall.
+#define VIDEO_BPP 16  // the panel's native RGB565.
+#define SCREEN_WIDTH 240
+#define SCREEN_HEIGHT 160
+#define MIN_CELL_SIZE 4  // the smallest cell which still shows the links.
+#define MAX_CELL_SIZE 16
+#define DIRTY_MAX 9  // rects a frame can change: five cells for a move, three for the motion, the overlay.
+#define DEMO_IDLE_MS 10000  // how long a game over waits for a key before the demo.
+#define DEMO_EVENT SDL_USEREVENT  // pushed when a game over has waited DEMO_IDLE_MS.
+
+
+// A way of opening the screen.
+struct _VideoMode {
+    const char* name;
+    uint32_t flags;
+};
+typedef struct _VideoMode VideoMode;
 
-#define UP 1
-#define RIGHT 2
-#define DOWN 3
-#define LEFT 4
 
+// The video modes to try, best first.  Every one asks for the panel's own
+// pixel format, so that nothing is converted on the way to it.
+static const VideoMode videoModes[] = {
+    {"double", SDL_HWSURFACE | SDL_DOUBLEBUF},  // page flipped on vblank.
+    {"hw", SDL_HWSURFACE},
+    {"sw", SDL_SWSURFACE},
+};
+#define VIDEO_MODE_COUNT (sizeof(videoModes) / sizeof(videoModes[0]))
 
-// A ring buffer.
-struct _RingBuf {
-    void* firstp;
-    void* lastp;
-    size_t unitSize;
+
+// How the time between ticks shrinks as the snake grows: startMs for a snake
+// of one block, stepMs less per block after that, but never below minMs.
+struct _SpeedCurve {
+    uint32_t startMs;
+    uint32_t minMs;
+    uint32_t stepMs;
 };
-typedef struct _RingBuf RingBuf;
+typedef struct _SpeedCurve SpeedCurve;
 
 
-// Initialize a ring buffer.
-void ringInit(RingBuf* ringp, size_t unitSize, size_t count) {
-    ringp->unitSize = unitSize;
-    size_t size = unitSize * count;
-    ringp->firstp = malloc(size);
-    assert(ringp->firstp != NULL);
-    ringp->lastp = (uint8_t*)(ringp->firstp) + size - unitSize;
-}
+// The front end state: the game, plus everything needed to show and pace it.
+struct _Game {
+    State state;
+    Arena arena;  // every buffer of the game, the autopilot included.
 
+    uint8_t cellSize;  // as large as fits the board on the screen.
+    int16_t originX;  // where the board starts, so that it is centred.
+    int16_t originY;
+    const char* videoMode;  // the first video mode to try, or "auto".
+    SDL_Surface* screenp;
+    bool pageFlipping;  // the screen is double buffered.
+    bool incrementalDraw;  // only repaint the cells which changed.
+    bool directDraw;  // write the board straight into the locked screen.
+    bool redrawAll;  // the next frame must be a full repaint.
+    // on a double buffered screen, what the last frame changed, so that the
+    // other buffer can be brought up to it before it is drawn on.
+    SDL_Surface* carryp;
+    SDL_Rect carried[DIRTY_MAX];
+    int carriedCount;
+    SnakeNode drawnTail;  // the tail as of the last frame.
+    uint32_t drawnTick;  // the tick count as of the last frame.
+    uint32_t framePeriod;  // how often to draw, in milliseconds.
+    uint32_t lastFrame;
+    SpeedCurve speed;
+    bool paused;
 
-// Return the next slot in a ring buffer.
-void* ringNext(RingBuf* ringp, void* currentp) {
-    void* nextp = ((uint8_t*)currentp) + ringp->unitSize;
-    assert(nextp > currentp);  // check for overflow.
-    if (nextp > ringp->lastp) {
-        nextp = ringp->firstp;
-    }
-    return nextp;
+    // the motion drawn between ticks.
+    bool interpolate;
+    uint8_t progress;  // how many pixels of the way into the tick to draw.
+    uint8_t drawnProgress;  // the progress as of the last frame.
+    bool moved;  // the last tick moved the snake on by one block.
+    bool hasVacated;  // ... and the tail left a cell which is now empty.
+    SnakeNode vacated;
+
+    uint32_t startTicks;  // when the main loop started.
+    uint32_t wakeups;  // times the main loop has woken up since.
+
+    // turns waiting for their tick, oldest first, and when each was read.
+    uint8_t turnQueue[TURN_QUEUE_SIZE];
+    uint64_t turnReadNs[TURN_QUEUE_SIZE];
+    int turnCount;
+
+    bool hasLevel;
+    Level level;
+
+    uint32_t bgColor;
+    uint32_t wallColor;
+    uint32_t snakeColor;
+    uint32_t foodColor;
+    Atlas atlas;
+
+    bool recording;
+    Recorder recorder;
+    bool replaying;
+    Player player;
+    bool autopiloting;
+    Autopilot autopilot;
+    bool hasDemo;  // a demo can be played while a game over waits for a key.
+    bool demoing;  // the demo is playing now.
+    SDL_TimerID demoTimer;  // counting down to the demo, while a game over waits.
+    Player demo;
+
+    const char* snapshotPath;  // where the game is saved on exit, if anywhere.
+
+    const char* scoresPath;  // where the stats are kept, if anywhere.
+    Scores scores;
+    uint32_t gameStartTick;  // the first tick of this game not yet in the stats.
+
+    Telemetry telemetry;  // the stream to a viewer, if any.
+
+    Startup startup;  // how long it took to get the game on the screen.
+    Timing timing;
+    const char* timingPath;  // where to write the timing CSV on exit.
+    bool timingOverlay;
+    Pacing pacing;  // how evenly the frames come, always measured.
+    const char* pacingPath;  // where to write the pacing summary on exit.
+    uint32_t overlayColor;
+};
+typedef struct _Game Game;
+
+
+// Does the game being played count towards the stats?  Only the player's
+// own games do.
+bool countsForScores(Game* gamep) {
+    return gamep->scoresPath != NULL && gamep->replaying == false && gamep->autopiloting == false &&
+        gamep->demoing == false;
 }
 
 
-// Return the previous slot in a ring buffer.
-void* ringPrev(RingBuf* ringp, void* currentp) {
-    void* prevp = ((uint8_t*)currentp) - ringp->unitSize;
-    assert(prevp < currentp);  // check for underflow.
-    if (prevp < ringp->firstp) {
-        prevp = ringp->lastp;
+// Write the stats back if they have changed.  Only called where a slow SD
+// card write can't hold up a frame.
+void flushScores(Game* gamep) {
+    if (gamep->scoresPath != NULL && scoresFlush(&(gamep->scores), gamep->scoresPath) == false) {
+        fprintf(stderr, "can't save the scores to %s\n", gamep->scoresPath);
     }
-    return prevp;
 }
 
 
-// One block of a snake body.
-struct _SnakeNode {
-    uint8_t x;
-    uint8_t y;
-};
-typedef struct _SnakeNode SnakeNode;
-
+// Exit the game (terminate the process).
+void quit(Game* gamep, int status) {
+    if (gamep->recording && recorderClose(&(gamep->recorder), gamep->state.tickCount) == false) {
+        fprintf(stderr, "can't write the end of the replay\n");
+    }
+    // save a game in progress, and forget one which is over: the demo only
+    // ever plays after a game over.
+    if (status == 0 && gamep->snapshotPath != NULL && gamep->replaying == false) {
+        if (gamep->state.crashed || gamep->demoing) {
+            unlink(gamep->snapshotPath);
+        } else if (snapshotSave(&(gamep->state), gamep->snapshotPath) == false) {
+            fprintf(stderr, "can't save the game to %s\n", gamep->snapshotPath);
+        }
+    }
+    // a game in progress still counts its ticks, but not as a game played.
+    if (countsForScores(gamep) && gamep->state.crashed == false) {
+        scoresAddTicks(&(gamep->scores), gamep->state.tickCount - gamep->gameStartTick);
+    }
+    flushScores(gamep);
+    if (gamep->timingPath != NULL && timingWriteCsv(&(gamep->timing), gamep->timingPath) == false) {
+        fprintf(stderr, "can't write timing to %s\n", gamep->timingPath);
+    }
+    double seconds = (SDL_GetTicks() - gamep->startTicks) / 1000.0;
+    printf("wakeups: %u in %.1f s (%.1f per second)\n", gamep->wakeups, seconds,
+        seconds > 0 ? gamep->wakeups / seconds : 0);
+    pacingPrint(&(gamep->pacing));
+    if (gamep->pacingPath != NULL && pacingWrite(&(gamep->pacing), gamep->pacingPath) == false) {
+        fprintf(stderr, "can't write pacing to %s\n", gamep->pacingPath);
+    }
+    Telemetry* telemetryp = &(gamep->telemetry);
+    if (telemetryp->fd >= 0) {
+        printf("telemetry: %llu packets, %llu bytes, %llu keyframes, %llu dropped\n",
+            (unsigned long long)telemetryp->packets, (unsigned long long)telemetryp->bytes,
+            (unsigned long long)telemetryp->keyframes, (unsigned long long)telemetryp->dropped);
+        telemetryClose(telemetryp);
+    }
+    if (gamep->hasLevel) {
+        levelClose(&(gamep->level));
+    }
+    if (gamep->autopiloting) {
+        Autopilot* autopilotp = &(gamep->autopilot);
+        printf("autopilot: worst steer %.3f ms, budget %.3f ms\n", autopilotp->worstNs / 1e6,
+            autopilotp->budgetUs / 1e3);
+    }
+    printf("memory: arena %zu bytes, peak rss %ld KB\n", gamep->arena.peak, peakRssKb());
+    SDL_Quit();
+    exit(status);
+}
 
-// A block of food.
-struct _Food {
-    uint8_t x;
-    uint8_t y;
-};
-typedef struct _Food Food;
 
+// Start a new game, and make sure the next frame repaints everything.
+void newGame(Game* gamep) {
+    restart(&(gamep->state));
+    gamep->gameStartTick = gamep->state.tickCount;
+    gamep->redrawAll = true;
+    gamep->turnCount = 0;
+    gamep->moved = false;
+}
 
-// The game state.
-struct _State {
-    uint8_t cellSize;
-    uint8_t gridWidth;
-    uint8_t gridHeight;
 
-    bool crashed;
-    uint8_t direction;
+// Start the demo from the beginning, on the buffers of the game which is
+// over: only the tick count and the generator go back to how the recording
+// started.
+void startDemo(Game* gamep) {
+    State* statep = &(gamep->state);
+    Player* demop = &(gamep->demo);
+    playerRewind(demop);
+    statep->tickCount = 0;
+    seedRandom(statep, demop->header.seed);
+    newGame(gamep);
+    gamep->demoing = true;
+}
 
-    RingBuf ring;
-    SnakeNode* headp;
-    SnakeNode* tailp;
 
-    Food food;
+// Is the game waiting for a key, with nothing to show until one comes?  A
+// crashed replay, demo or autopilot game restarts by itself, so it never is.
+bool isIdle(Game* gamep) {
+    if (gamep->paused) {
+        return true;
+    }
+    return gamep->state.crashed && gamep->replaying == false && gamep->autopiloting == false &&
+        gamep->demoing == false;
+}
 
-    SDL_Surface* screenp;
-    uint32_t framePeriod;
-    uint32_t lastFrame;
 
-    uint32_t bgColor;
-    uint32_t snakeColor;
-};
-typedef struct _State State;
+// Push the event which starts the demo.  Called on SDL's timer thread, once.
+Uint32 demoTimerFired(Uint32 interval, void* paramp) {
+    (void)interval;
+    (void)paramp;
+    SDL_Event event;
+    event.type = DEMO_EVENT;
+    event.user.code = 0;
+    event.user.data1 = NULL;
+    event.user.data2 = NULL;
+    SDL_PushEvent(&event);
+    return 0;  // don't fire again.
+}
 
 
-// Exit the game (terminate the process).
-void quit(int status) {
-    SDL_Quit();
-    exit(status);
+// Stop counting down to the demo, if it still is.  Its event may be queued
+// already, so the event handler checks again whether the demo is wanted.
+void cancelDemoTimer(Game* gamep) {
+    if (gamep->demoTimer != NULL) {
+        SDL_RemoveTimer(gamep->demoTimer);
+        gamep->demoTimer = NULL;
+    }
 }
 
 
-// Iterate to the next block of the snake body.
-// Returns NULL when you run off the end.
-SnakeNode* snakeNext(State* statep, SnakeNode* snakep) {
-    if (snakep == statep->tailp) {
-        return NULL;
-    } else {
-        return ringNext(&(statep->ring), snakep);
+// Return the time between ticks, for the snake as long as it is now.
+uint32_t tickPeriod(Game* gamep) {
+    State* statep = &(gamep->state);
+    SpeedCurve* speedp = &(gamep->speed);
+    uint32_t length = coveredCells(statep);
+    uint32_t faster = speedp->stepMs * (length - 1);
+    if (faster + speedp->minMs >= speedp->startMs) {
+        return speedp->minMs;
     }
+    return speedp->startMs - faster;
 }
 
 
-// Does the snake head collide with the food block?
-bool foodCollidesWithSnake(State* statep) {
-    SnakeNode* cursorp = statep->headp;
-    while (cursorp != NULL) {
-        if (statep->food.x == cursorp->x && statep->food.y == cursorp->y) {
-            return true;
-        }
-        cursorp = snakeNext(statep, cursorp);
+// Queue a turn for a later tick.  Turns which would do nothing by the time
+// they are applied (the same direction again, or a reversal) are dropped, as
+// are turns which don't fit in the queue.
+void queueTurn(Game* gamep, uint8_t direction) {
+    int count = gamep->turnCount;
+    uint8_t last = count > 0 ? gamep->turnQueue[count - 1] : playerSnake(&(gamep->state))->direction;
+    if (count == TURN_QUEUE_SIZE || direction == last || direction == reverseDirection(last)) {
+        return;
     }
-    return false;
+    gamep->turnQueue[count] = direction;
+    gamep->turnReadNs[count] = timingStart(&(gamep->timing));
+    gamep->turnCount++;
 }
 
 
-// Respawn the food into a new location which does not collide with the snake.
-void respawnFood(State* statep) {
-    // TODO: this approach will become non-performant as the snake fills
-    // the screen (more and more re-rolls will be required to find an open
-    // block).
-    while (true) {
-        statep->food.x = rand() % statep->gridWidth;
-        statep->food.y = rand() % statep->gridHeight;
-        if (foodCollidesWithSnake(statep)) {
-            continue;
-        } else {
-            break;
-        }
+// Log a turn to the recording.  A recording which can't be written any more
+// (on a full card, say) is stopped, and the game goes on without it.
+void recordGameTurn(Game* gamep, uint8_t direction) {
+    if (recordTurn(&(gamep->recorder), gamep->state.tickCount, direction) == false) {
+        fprintf(stderr, "can't write the replay: recording stopped at tick %u\n", gamep->state.tickCount);
+        gamep->recording = false;
     }
 }
 
 
-// Does the snake head collide with its body?
-bool snakeCollidesWithSnake(State* statep) {
-    if (statep->headp == statep->tailp) {
+// Apply the oldest queued turn, if there is one.  Returns true if the snake
+// turned, and sets *readNsp to when the key was read.
+bool applyQueuedTurn(Game* gamep, uint64_t* readNsp) {
+    if (gamep->turnCount == 0) {
         return false;
     }
-    SnakeNode* cursorp = snakeNext(statep, statep->headp);
-    while (cursorp != NULL) {
-        if (statep->headp->x == cursorp->x && statep->headp->y == cursorp->y) {
-            return true;
-        }
-        cursorp = snakeNext(statep, cursorp);
+    State* statep = &(gamep->state);
+    uint8_t direction = gamep->turnQueue[0];
+    *readNsp = gamep->turnReadNs[0];
+    gamep->turnCount--;
+    memmove(gamep->turnQueue, gamep->turnQueue + 1, gamep->turnCount * sizeof(uint8_t));
+    memmove(gamep->turnReadNs, gamep->turnReadNs + 1, gamep->turnCount * sizeof(uint64_t));
+    if (turnSnake(playerSnake(statep), direction) == false) {
+        return false;
+    }
+    if (gamep->recording) {
+        recordGameTurn(gamep, direction);
     }
-    return false;
+    return true;
 }
 
 
-// Would the snake be out of bounds after advancing the snake head?
-bool wouldBeOutOfBounds(State* statep) {
-    uint8_t direction = statep->direction;
-    SnakeNode* headp = statep->headp;
-    switch (direction) {
-        case UP:
-            if (headp->y == 0) {
-                return true;
-            }
-            break;
-        case DOWN:
-            if (headp->y == statep->gridHeight - 1) {
-                return true;
-            }
-            break;
-        case LEFT:
-            if (headp->x == 0) {
-                return true;
-            }
-            break;
-        case RIGHT:
-            if (headp->x == statep->gridWidth - 1) {
-                return true;
-            }
-            break;
-        default:
-            unreachable;
-    }
-    return false;
+// Return the size of a cell on the screen: a constant in a build for one
+// cell size (see tiles.h).
+static inline uint8_t gameCellSize(Game* gamep) {
+#ifdef CELL_SIZE
+    (void)gamep;
+    return CELL_SIZE;
+#else
+    return gamep->cellSize;
+#endif
 }
 
 
-// Advance the snake by one block.
-void moveSnake(State* statep) {
-    if (wouldBeOutOfBounds(statep)) {
-        statep->crashed = true;
-    }
-    if (statep->crashed) {
-        return;
-    }
+// Return the screen rectangle covered by a grid cell.
+SDL_Rect cellRect(Game* gamep, Coord x, Coord y) {
+    uint8_t cellSize = gameCellSize(gamep);
+    SDL_Rect rect = {gamep->originX + x * cellSize, gamep->originY + y * cellSize, cellSize, cellSize};
+    return rect;
+}
+
 
-    SnakeNode* newHeadp = ringPrev(&(statep->ring), statep->headp);
-    newHeadp->x = statep->headp->x;
-    newHeadp->y = statep->headp->y;
-    if (statep->direction == UP) {
-        newHeadp->y--;
-    } else if (statep->direction == DOWN) {
-        newHeadp->y++;
-    } else if (statep->direction == LEFT) {
-        newHeadp->x--;
-    } else if (statep->direction == RIGHT) {
-        newHeadp->x++;
+// Repaint a grid cell which is not covered by the snake.
+SDL_Rect drawEmptyCell(Game* gamep, Coord x, Coord y) {
+    SDL_Rect rect = cellRect(gamep, x, y);
+    if (gamep->directDraw) {
+        rasterFill(gamep->screenp, &rect, gamep->bgColor);
     } else {
-        unreachable;
+        SDL_FillRect(gamep->screenp, &rect, gamep->bgColor);
     }
-    statep->headp = newHeadp;
+    return rect;
+}
+
+
+// Repaint the grid cell covered by the block at ring index i, which is at
+// nodep, including the links towards its neighbours.
+SDL_Rect drawSnakeCell(Game* gamep, uint32_t i, SnakeNode* nodep) {
+    SDL_Rect cell = cellRect(gamep, nodep->x, nodep->y);
+    atlasBlit(&(gamep->atlas), snakeTile(playerSnake(&(gamep->state)), i), gamep->screenp, cell);
+    return cell;
+}
+
+
+// Draw the snake, one tile per block.
+void drawSnake(Game* gamep) {
+    State* statep = &(gamep->state);
+    atlasDrawSnake(&(gamep->atlas), statep, playerSnake(statep), gamep->screenp, gamep->originX, gamep->originY);
+}
+
+
+// Draw the food.
+void drawFood(Game* gamep) {
+    State* statep = &(gamep->state);
+    SDL_Rect cell = cellRect(gamep, statep->food.x, statep->food.y);
+    atlasBlit(&(gamep->atlas), TILE_FOOD, gamep->screenp, cell);
+}
+
 
-    bool didEat = false;
-    if (statep->headp->x == statep->food.x && statep->headp->y == statep->food.y) {
-        didEat = true;
-        respawnFood(statep);
+// Repaint only the cells which changed during the last tick (the new head,
+// the old head, the old and new tail and the food).  Their rectangles are
+// added to dirty; returns how many.
+int drawIncremental(Game* gamep, SDL_Rect* dirty) {
+    State* statep = &(gamep->state);
+    Timing* timingp = &(gamep->timing);
+    int count = 0;
+
+    uint64_t startNs = timingStart(timingp);
+    SnakeNode* oldTailp = &(gamep->drawnTail);
+    if (isOccupied(statep, oldTailp->x, oldTailp->y) == false) {
+        dirty[count++] = drawEmptyCell(gamep, oldTailp->x, oldTailp->y);
     }
-    if (didEat == false) {
-        statep->tailp = ringPrev(&(statep->ring), statep->tailp);
+    Snake* snakep = playerSnake(statep);
+    dirty[count++] = drawSnakeCell(gamep, snakep->head, snakeHead(snakep));
+    if (snakep->head != snakep->tail) {
+        Ring* ringp = &(snakep->ring);
+        SnakeNode neck = *snakeHead(snakep);
+        stepOnBoard(statep, &neck, ringLink(ringp, snakep->head));
+        dirty[count++] = drawSnakeCell(gamep, ringNext(ringp, snakep->head), &neck);
+        dirty[count++] = drawSnakeCell(gamep, snakep->tail, snakeTail(snakep));
     }
+    timingStop(timingp, PHASE_SNAKE, startNs);
 
-    if (snakeCollidesWithSnake(statep)) {
-        statep->crashed = true;
-    }
+    startNs = timingStart(timingp);
+    drawFood(gamep);
+    dirty[count++] = cellRect(gamep, statep->food.x, statep->food.y);
+    timingStop(timingp, PHASE_FOOD, startNs);
+    return count;
 }
 
 
-// Restart: start a new game.
-void restart(State* statep) {
-    statep->headp = statep->ring.firstp;
-    statep->tailp = statep->headp;
-    statep->headp->x = rand() % statep->gridWidth;
-    statep->headp->y = rand() % statep->gridHeight;
+// Draw the head sliding into the cell it has just entered, and the tail
+// sliding out of the cell it has just left, progress pixels of the way
+// through the tick.  At full progress this is just the blocks as they are.
+// Their rectangles are added to dirty; returns how many.
+int drawMotion(Game* gamep, SDL_Rect* dirty) {
+    Snake* snakep = playerSnake(&(gamep->state));
+    Ring* ringp = &(snakep->ring);
+    Atlas* atlasp = &(gamep->atlas);
+    uint8_t cellSize = gameCellSize(gamep);
+    uint8_t progress = gamep->progress;
+    int count = 0;
+    if (gamep->moved == false) {
+        return count;
+    }
+    if (progress >= cellSize) {
+        progress = cellSize;
+    }
 
-    respawnFood(statep);
+    if (progress == cellSize) {
+        dirty[count++] = drawSnakeCell(gamep, snakep->head, snakeHead(snakep));
+    } else if (snakep->head != snakep->tail) {
+        SnakeNode* headp = snakeHead(snakep);
+        uint8_t side = ringLink(ringp, snakep->head);
+        SDL_Rect cell = drawEmptyCell(gamep, headp->x, headp->y);
+        atlasBlitEdge(atlasp, snakeTile(snakep, snakep->head), side, progress, gamep->screenp, cell);
+        dirty[count++] = cell;
+    }
+    if (gamep->hasVacated) {
+        SnakeNode* vacatedp = &(gamep->vacated);
+        SnakeNode* tailp = snakeTail(snakep);
+        uint8_t side = reverseDirection(ringLink(ringp, snakep->tail));
+        SDL_Rect cell = drawEmptyCell(gamep, vacatedp->x, vacatedp->y);
+        atlasBlitEdge(atlasp, TILE_TAIL + side, side, cellSize - progress, gamep->screenp, cell);
+        dirty[count++] = cell;
+        if (progress == cellSize) {
+            dirty[count++] = drawSnakeCell(gamep, snakep->tail, tailp);
+            return count;
+        }
+        // keep the tail joined to the part of it still to leave.
+        uint8_t links = TILE_LINK(reverseDirection(side));
+        if (snakep->tail != snakep->head) {
+            links |= TILE_LINK(reverseDirection(ringLink(ringp, ringPrev(ringp, snakep->tail))));
+        }
+        cell = cellRect(gamep, tailp->x, tailp->y);
+        atlasBlit(atlasp, TILE_BODY + links, gamep->screenp, cell);
+        dirty[count++] = cell;
+    }
+    return count;
+}
 
-    statep->crashed = false;
 
-    if (statep->headp->x > statep->gridWidth / 2) {
-        statep->direction = LEFT;
+// Draw the background, over the whole screen: the board may not cover all
+// of it, and the pause text may run off the edge of the board.  The walls of
+// the level, if any, are part of it.
+void drawBG(Game* gamep) {
+    if (gamep->directDraw) {
+        rasterFill(gamep->screenp, NULL, gamep->bgColor);
     } else {
-        statep->direction = RIGHT;
+        SDL_FillRect(gamep->screenp, NULL, gamep->bgColor);
+    }
+    if (gamep->hasLevel == false) {
+        return;
+    }
+    Level* levelp = &(gamep->level);
+    size_t count = (size_t)levelp->gridWidth * levelp->gridHeight;
+    for (size_t i = 0; i < count; i++) {
+        if (((levelp->wallsp[i >> 3] >> (i & 7)) & 1) == 0) {
+            continue;
+        }
+        SDL_Rect rect = cellRect(gamep, i % levelp->gridWidth, i / levelp->gridWidth);
+        if (gamep->directDraw) {
+            rasterFill(gamep->screenp, &rect, gamep->wallColor);
+        } else {
+            SDL_FillRect(gamep->screenp, &rect, gamep->wallColor);
+        }
     }
 }
 
 
-// Deduce the direction, based on two snake blocks.
-uint8_t getDirection(SnakeNode* s1p, SnakeNode* s2p) {
-    if (s1p->x < s2p->x && s1p->y == s2p->y) {
-        return RIGHT;
-    } else if (s2p->x < s1p->x && s1p->y == s2p->y) {
-        return LEFT;
-    } else if (s1p->x == s2p->x && s1p->y < s2p->y) {
-        return DOWN;
-    } else if (s1p->x == s2p->x && s2p->y < s1p->y) {
-        return UP;
-    } else {
-        unreachable;
-    }
-}
-
-// Draw the snake.
-void drawSnake(State* statep) {
-    SnakeNode* cursorp = statep->headp;
-    int16_t x;
-    int16_t y;
-    int16_t w;
-    int16_t h;
-    uint8_t cellSize = statep->cellSize;
-
-    uint32_t color = statep->snakeColor;
-
-    // draw two nodes at a time, so that the connecting link is also drawn.
-    while (cursorp != statep->tailp) {
-        SnakeNode* snake2p = ringNext(&(statep->ring), cursorp);
-        uint8_t direction = getDirection(cursorp, snake2p);
-        // x, y
-        switch (direction) {
-            case RIGHT:
-            case DOWN:
-                x = cursorp->x * cellSize;
-                y = cursorp->y * cellSize;
-                break;
-            case LEFT:
-            case UP:
-                x = snake2p->x * cellSize;
-                y = snake2p->y * cellSize;
-                break;
-            default:
-                unreachable;
-        }
-        // w, h
-        switch (direction) {
-            case RIGHT:
-            case LEFT:
-                w = cellSize * 2;
-                h = cellSize;
-                break;
-            case UP:
-            case DOWN:
-                w = cellSize;
-                h = cellSize * 2;
-                break;
-            default:
-                unreachable;
-        }
-        // inset
-        x += 1;
-        y += 1;
-        w -= 2;
-        h -= 2;
-        SDL_Rect rect = {x, y, w, h};
-        SDL_FillRect(statep->screenp, &rect, color);
-
-        cursorp = snake2p;
-        continue;
+// Lock the screen for drawing the board directly, once for the whole frame.
+void lockBoard(Game* gamep) {
+    if (gamep->directDraw) {
+        int ret = SDL_LockSurface(gamep->screenp);
+        assert(ret == 0);
     }
+}
+
 
-    // draw the last block.
-    x = cursorp->x * cellSize;
-    y = cursorp->y * cellSize;
-    w = cellSize;
-    h = cellSize;
-    // inset
-    x += 1;
-    y += 1;
-    w -= 2;
-    h -= 2;
-    SDL_Rect rect = {x, y, w, h};
-    SDL_FillRect(statep->screenp, &rect, color);
+// Unlock the screen once the board is drawn, before anything goes through
+// SDL again.
+void unlockBoard(Game* gamep) {
+    if (gamep->directDraw) {
+        SDL_UnlockSurface(gamep->screenp);
+    }
 }
 
 
-// Draw the food.
-void drawFood(State* statep) {
-    int16_t x = statep->food.x * statep->cellSize;
-    int16_t y = statep->food.y * statep->cellSize;
-    uint16_t w = statep->cellSize;
-    uint16_t h = statep->cellSize;
-    SDL_Rect rect = {x, y, w, h};
-    uint32_t color = SDL_MapRGB(statep->screenp->format, 0xFF, 0x00, 0x00);
-    SDL_FillRect(statep->screenp, &rect, color);
+// Show that the game is paused, in the middle of the screen.
+void drawPaused(Game* gamep) {
+    const char* textp = "PAUSED";
+    int x = (gamep->screenp->w - (int)strlen(textp) * FONT_ADVANCE) / 2;
+    int y = (gamep->screenp->h - FONT_HEIGHT) / 2;
+    drawText(gamep->screenp, x, y, textp, gamep->overlayColor);
 }
 
 
-// Draw the background.
-void drawBG(State* statep) {
-    int16_t x = 0;
-    int16_t y = 0;
-    uint16_t w = statep->gridWidth * statep->cellSize;
-    uint16_t h = statep->gridHeight * statep->cellSize;
-    SDL_Rect rect = {x, y, w, h};
-    SDL_FillRect(statep->screenp, &rect, statep->bgColor);
+// Bring the back buffer of a double buffered screen up to the last frame.
+// It was last drawn on two frames ago, and the frame since differs from that
+// only in the cells it changed, so copying those back makes it match the
+// screen and ready for this frame's changes.
+void restoreCarried(Game* gamep) {
+    for (int i = 0; i < gamep->carriedCount; i++) {
+        SDL_Rect rect = gamep->carried[i];  // blits clip the rects they are given.
+        SDL_BlitSurface(gamep->carryp, &rect, gamep->screenp, &rect);
+    }
+    gamep->carriedCount = 0;
 }
 
 
-// Perform all drawing.  Called once per frame.
-void draw(State* statep) {
-    drawBG(statep);
-    drawSnake(statep);
-    if (statep->crashed == false) {
-        drawFood(statep);
+// Keep what this frame changed on a double buffered screen, before it is
+// flipped away, for restoreCarried() to copy into the other buffer.
+void carry(Game* gamep, SDL_Rect* rectsp, int count) {
+    assert(count <= DIRTY_MAX);
+    for (int i = 0; i < count; i++) {
+        SDL_Rect rect = rectsp[i];
+        gamep->carried[i] = rect;
+        SDL_BlitSurface(gamep->screenp, &rect, gamep->carryp, &rect);
     }
-    SDL_Flip(statep->screenp);
+    gamep->carriedCount = count;
 }
 
 
-// Update the game state.  Called once per frame.
-void update(State* statep) {
+// Perform all drawing.  Called once per frame, but does nothing if nothing
+// has changed since the last one.
+void draw(Game* gamep) {
+    State* statep = &(gamep->state);
+    Timing* timingp = &(gamep->timing);
+    uint64_t startNs;
+    // the board only ever changes by a move, by the motion between moves,
+    // or by something which asks for a full repaint.
+    bool newTick = statep->tickCount != gamep->drawnTick;
+    if (gamep->redrawAll == false && newTick == false && gamep->progress == gamep->drawnProgress) {
+        return;
+    }
+    if (gamep->incrementalDraw && gamep->redrawAll == false) {
+        SDL_Rect dirty[DIRTY_MAX];
+        int count = 0;
+        startNs = timingStart(timingp);
+        restoreCarried(gamep);
+        timingStop(timingp, PHASE_BG, startNs);
+        lockBoard(gamep);
+        if (newTick) {
+            count = drawIncremental(gamep, dirty);
+        }
+        startNs = timingStart(timingp);
+        count += drawMotion(gamep, dirty + count);
+        timingStop(timingp, PHASE_SNAKE, startNs);
+        unlockBoard(gamep);
+        if (gamep->timingOverlay) {
+            dirty[count++] = drawTimingOverlay(gamep->screenp, timingp, &(gamep->pacing), gamep->overlayColor, gamep->bgColor);
+        }
+        startNs = timingStart(timingp);
+        if (gamep->pageFlipping) {
+            carry(gamep, dirty, count);
+            SDL_Flip(gamep->screenp);
+        } else {
+            SDL_UpdateRects(gamep->screenp, count, dirty);
+        }
+        timingStop(timingp, PHASE_FLIP, startNs);
+    } else {
+        lockBoard(gamep);
+        startNs = timingStart(timingp);
+        drawBG(gamep);
+        timingStop(timingp, PHASE_BG, startNs);
+
+        SDL_Rect dirty[3];
+        startNs = timingStart(timingp);
+        drawSnake(gamep);
+        drawMotion(gamep, dirty);
+        timingStop(timingp, PHASE_SNAKE, startNs);
+
+        if (statep->crashed == false) {
+            startNs = timingStart(timingp);
+            drawFood(gamep);
+            timingStop(timingp, PHASE_FOOD, startNs);
+        }
+        unlockBoard(gamep);
+        if (gamep->timingOverlay) {
+            drawTimingOverlay(gamep->screenp, timingp, &(gamep->pacing), gamep->overlayColor, gamep->bgColor);
+        }
+        if (gamep->paused) {
+            drawPaused(gamep);
+        }
+
+        startNs = timingStart(timingp);
+        if (gamep->carryp != NULL) {
+            SDL_Rect all = {0, 0, gamep->screenp->w, gamep->screenp->h};
+            carry(gamep, &all, 1);
+        }
+        SDL_Flip(gamep->screenp);
+        timingStop(timingp, PHASE_FLIP, startNs);
+        gamep->redrawAll = false;
+    }
+    gamep->drawnTail = *snakeTail(playerSnake(statep));
+    gamep->drawnTick = statep->tickCount;
+    gamep->drawnProgress = gamep->progress;
+}
+
+
+// Handle the pending input events.  Turns are queued rather than applied, so
+// that several keys pressed within one tick each get a tick of their own.
+// Returns false if the rest of the tick should be skipped (because a new game
+// was started).
+bool handleEvents(Game* gamep) {
+    State* statep = &(gamep->state);
     SDL_Event event;
     while (SDL_PollEvent(&event) == 1) {
         if (event.type == SDL_QUIT) {
             // the window was closed.
-            quit(0);
+            quit(gamep, 0);
+        } else if (event.type == DEMO_EVENT) {
+            // the game over has waited long enough, unless a key came first.
+            if (isIdle(gamep) && gamep->paused == false && gamep->hasDemo) {
+                gamep->demoTimer = NULL;  // it only fires once.
+                startDemo(gamep);
+                return false;
+            }
         } else if (event.type == SDL_KEYDOWN) {
             SDLKey k = event.key.keysym.sym;
             // check if we need to quit.
             if (k == SDLK_ESCAPE || k == SDLK_q) {
-                quit(0);
+                quit(gamep, 0);
+            }
+            // any key (other than quit) stops the demo and starts a game
+            // straight away, on the same state.
+            if (gamep->demoing) {
+                gamep->demoing = false;
+                newGame(gamep);
+                return false;
+            }
+            // Start pauses and resumes, whoever is playing.
+            if (k == SDLK_RETURN && statep->crashed == false) {
+                gamep->paused = !gamep->paused;
+                gamep->redrawAll = true;
+                continue;
+            }
+            // other keys are ignored while paused, replaying or on autopilot.
+            if (gamep->paused || gamep->replaying || gamep->autopiloting) {
+                continue;
             }
             // if crashed, any key (other than quit) restarts.
             if (statep->crashed == true) {
-                restart(statep);
-                return;
+                newGame(gamep);
+                return false;
             }
             // check if we need to change direction.
-            // (but only process one direction change per frame).
-            if (k == SDLK_UP && statep->direction != DOWN) {
-                statep->direction = UP;
-                break;
-            } else if (k == SDLK_DOWN && statep->direction != UP) {
-                statep->direction = DOWN;
-                break;
-            } else if (k == SDLK_LEFT && statep->direction != RIGHT) {
-                statep->direction = LEFT;
-                break;
-            } else if (k == SDLK_RIGHT && statep->direction != LEFT) {
-                statep->direction = RIGHT;
-                break;
+            uint8_t direction = 0;
+            if (k == SDLK_UP) {
+                direction = UP;
+            } else if (k == SDLK_DOWN) {
+                direction = DOWN;
+            } else if (k == SDLK_LEFT) {
+                direction = LEFT;
+            } else if (k == SDLK_RIGHT) {
+                direction = RIGHT;
+            }
+            if (direction != 0) {
+                queueTurn(gamep, direction);
             }
         }
         continue;
     }
+    return true;
+}
+
+
+// Work out what the last tick moved, for drawMotion().  Takes the tail and
+// the tick count from before the tick.
+void noteMotion(Game* gamep, SnakeNode oldTail, uint32_t oldTick, bool wasCrashed) {
+    State* statep = &(gamep->state);
+    gamep->moved = wasCrashed == false && statep->crashed == false && statep->tickCount == oldTick + 1;
+    // the food may have been put straight into the cell the tail left.
+    gamep->hasVacated = gamep->moved && isOccupied(statep, oldTail.x, oldTail.y) == false &&
+        (statep->food.x != oldTail.x || statep->food.y != oldTail.y);
+    gamep->vacated = oldTail;
+}
+
+
+// Update the game state.  Called once per tick.
+void update(Game* gamep) {
+    State* statep = &(gamep->state);
+    Timing* timingp = &(gamep->timing);
+
+    uint64_t startNs = timingStart(timingp);
+    bool carryOn = handleEvents(gamep);
+    timingStop(timingp, PHASE_INPUT, startNs);
+    if (carryOn == false || gamep->paused) {
+        return;
+    }
+    SnakeNode oldTail = *snakeTail(playerSnake(statep));
+    uint32_t oldTick = statep->tickCount;
+    bool wasCrashed = statep->crashed;
+
+    if (gamep->replaying) {
+        // the replay restarts by itself after a crash.
+        startNs = timingStart(timingp);
+        bool replayOver = replayTick(&(gamep->player), statep) == false;
+        timingStop(timingp, PHASE_MOVE, startNs);
+        if (replayOver) {
+            // the replay is over: hand control over to the player.
+            if (gamep->player.corrupt) {
+                fprintf(stderr, "the replay is corrupt after tick %u: handing over\n", statep->tickCount);
+            }
+            playerClose(&(gamep->player));
+            gamep->replaying = false;
+            gamep->gameStartTick = statep->tickCount;
+        }
+        if (wasCrashed || statep->crashed) {
+            gamep->redrawAll = true;
+        }
+        noteMotion(gamep, oldTail, oldTick, wasCrashed);
+        return;
+    }
+    if (gamep->demoing) {
+        // the demo loops until a key is pressed.
+        startNs = timingStart(timingp);
+        bool demoOver = replayTick(&(gamep->demo), statep) == false;
+        timingStop(timingp, PHASE_MOVE, startNs);
+        if (demoOver && gamep->demo.corrupt) {
+            // it would only go wrong at the same place every time round.
+            fprintf(stderr, "the demo is corrupt after tick %u: not playing it again\n", statep->tickCount);
+            playerClose(&(gamep->demo));
+            gamep->hasDemo = false;
+            gamep->demoing = false;
+            newGame(gamep);
+            return;
+        }
+        if (demoOver) {
+            startDemo(gamep);
+            return;
+        }
+        if (wasCrashed || statep->crashed) {
+            gamep->redrawAll = true;
+        }
+        noteMotion(gamep, oldTail, oldTick, wasCrashed);
+        return;
+    }
+    if (gamep->autopiloting) {
+        // the autopilot starts a new game by itself after a crash.
+        if (statep->crashed) {
+            newGame(gamep);
+            autopilotReset(&(gamep->autopilot));
+            return;
+        }
+        Snake* snakep = playerSnake(statep);
+        uint8_t direction = snakep->direction;
+        autopilotSteer(&(gamep->autopilot), statep, snakep);
+        if (gamep->recording && snakep->direction != direction) {
+            recordGameTurn(gamep, snakep->direction);
+        }
+    }
     if (!statep->crashed) {
+        uint64_t readNs = 0;
+        bool turned = applyQueuedTurn(gamep, &readNs);
+        startNs = timingStart(timingp);
         moveSnake(statep);
+        timingStop(timingp, PHASE_MOVE, startNs);
+        if (turned) {
+            timingStop(timingp, PHASE_LAG, readNs);
+        }
+        if (statep->crashed) {
+            gamep->redrawAll = true;
+            // only noted here: the stats are written once the game is idle.
+            if (countsForScores(gamep)) {
+                Scores* scoresp = &(gamep->scores);
+                scoresAddTicks(scoresp, statep->tickCount - gamep->gameStartTick);
+                scoresGameOver(scoresp, coveredCells(statep));
+                gamep->gameStartTick = statep->tickCount;
+            }
+        }
+        noteMotion(gamep, oldTail, oldTick, wasCrashed);
     }
 }
 
 
-// Perform all initialization.
-void init(State* statep) {
-    srand(time(NULL));
+// Open the screen in the first video mode which works, starting from the
+// one asked for.  If none of them do, take whatever the current mode is.
+void openVideo(Game* gamep, int width, int height) {
+    size_t first = 0;
+    if (strcmp(gamep->videoMode, "auto") != 0) {
+        while (first < VIDEO_MODE_COUNT && strcmp(videoModes[first].name, gamep->videoMode) != 0) {
+            first++;
+        }
+        if (first == VIDEO_MODE_COUNT) {
+            fprintf(stderr, "unknown video mode %s\n", gamep->videoMode);
+            first = 0;
+        }
+    }
+    gamep->screenp = NULL;
+    for (size_t i = first; i < VIDEO_MODE_COUNT && gamep->screenp == NULL; i++) {
+        if (SDL_VideoModeOK(width, height, VIDEO_BPP, videoModes[i].flags) != VIDEO_BPP) {
+            continue;
+        }
+        gamep->screenp = SDL_SetVideoMode(width, height, VIDEO_BPP, videoModes[i].flags);
+    }
+    if (gamep->screenp == NULL) {
+        int bpp = 0;  // use current bits per pixel.
+        gamep->screenp = SDL_SetVideoMode(width, height, bpp, SDL_SWSURFACE);
+    }
+    assert(gamep->screenp != NULL);
+
+    // report what we actually got, which need not be what was asked for.
+    uint32_t flags = gamep->screenp->flags;
+    SDL_PixelFormat* formatp = gamep->screenp->format;
+    gamep->pageFlipping = (flags & SDL_DOUBLEBUF) != 0;
+    bool rgb565 = formatp->Rmask == 0xF800 && formatp->Gmask == 0x07E0 && formatp->Bmask == 0x001F;
+    char driver[32];
+    if (SDL_VideoDriverName(driver, sizeof(driver)) == NULL) {
+        snprintf(driver, sizeof(driver), "unknown");
+    }
+    printf("video: %s, %dx%d, %ubpp%s, %s surface%s\n", driver, width, height,
+        formatp->BitsPerPixel, rgb565 ? " RGB565" : "",
+        (flags & SDL_HWSURFACE) ? "hardware" : "software",
+        gamep->pageFlipping ? ", double buffered" : "");
+}
 
-    int ret = SDL_Init(SDL_INIT_VIDEO);
-    assert(ret == 0);
 
-    statep->cellSize = 16;
-    statep->gridWidth = 15;
-    statep->gridHeight = 10;
+// Return the largest cell size which fits the board on the screen.  In a
+// build for one cell size, that size if it fits and 0 if it doesn't.
+uint8_t boardCellSize(State* statep) {
+#ifdef CELL_SIZE
+    bool fits = statep->gridWidth * CELL_SIZE <= SCREEN_WIDTH && statep->gridHeight * CELL_SIZE <= SCREEN_HEIGHT;
+    return fits ? CELL_SIZE : 0;
+#else
+    int cellSize = MAX_CELL_SIZE;
+    if (SCREEN_WIDTH / statep->gridWidth < cellSize) {
+        cellSize = SCREEN_WIDTH / statep->gridWidth;
+    }
+    if (SCREEN_HEIGHT / statep->gridHeight < cellSize) {
+        cellSize = SCREEN_HEIGHT / statep->gridHeight;
+    }
+    return cellSize;
+#endif
+}
 
-    int width = statep->gridWidth * statep->cellSize;
-    int height = statep->gridHeight * statep->cellSize;
-    int bpp = 0;  // use current bits per pixel.
-    uint32_t flags = SDL_HWSURFACE;
-    statep->screenp = SDL_SetVideoMode(width, height, bpp, flags);
-    assert(statep->screenp != NULL);
 
-    uint8_t r = 0;
-    uint8_t g = 255;
-    uint8_t b = 0;
-    statep->snakeColor = SDL_MapRGB(statep->screenp->format, r, g, b);
+// Perform the initialization the first frame needs.  The board size must
+// already be set.
+void init(Game* gamep, uint32_t seed) {
+    Startup* startupp = &(gamep->startup);
+    printf("seed: %u\n", seed);
+    seedRandom(&(gamep->state), seed);
 
-    statep->framePeriod = 200;  // in milliseconds
-    statep->lastFrame = 0;
+    int ret = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER);
+    assert(ret == 0);
+    startupMark(startupp, STARTUP_SDL);
 
-    size_t unitSize = sizeof(SnakeNode);
-    size_t count = statep->gridWidth * statep->gridHeight;
-    ringInit(&(statep->ring), unitSize, count);
+    State* statep = &(gamep->state);
+    statep->snakeCount = 1;
+    gamep->cellSize = boardCellSize(statep);
+    gamep->originX = (SCREEN_WIDTH - statep->gridWidth * gamep->cellSize) / 2;
+    gamep->originY = (SCREEN_HEIGHT - statep->gridHeight * gamep->cellSize) / 2;
+    openVideo(gamep, SCREEN_WIDTH, SCREEN_HEIGHT);
+    startupMark(startupp, STARTUP_VIDEO);
 
+    uint8_t r = 0;
+    uint8_t g = 255;
+    uint8_t b = 0;
+    gamep->snakeColor = SDL_MapRGB(gamep->screenp->format, r, g, b);
     r = 0;
     g = 0;
     b = 0;
-    statep->bgColor = SDL_MapRGB(statep->screenp->format, r, g, b);
+    gamep->bgColor = SDL_MapRGB(gamep->screenp->format, r, g, b);
+    gamep->wallColor = SDL_MapRGB(gamep->screenp->format, 0x80, 0x80, 0x80);
+    gamep->foodColor = SDL_MapRGB(gamep->screenp->format, 0xFF, 0x00, 0x00);
+    gamep->overlayColor = SDL_MapRGB(gamep->screenp->format, 0xFF, 0xFF, 0xFF);
+    startupMark(startupp, STARTUP_COLORS);
+
+    gamep->framePeriod = 16;  // about the panel refresh rate.
+    gamep->lastFrame = 0;
+    pacingInit(&(gamep->pacing), gamep->framePeriod);
+    gamep->paused = false;
+    gamep->progress = gamep->cellSize;
+
+    // one block for everything, taken now: nothing is allocated later.
+    size_t bytes = gameBytes(statep);
+    bytes += gamep->autopiloting ? autopilotBytes(statep) : 0;
+    bytes += gamep->hasLevel ? levelBytes(statep) : 0;
+    arenaInit(&(gamep->arena), bytes);
+    initGame(statep, &(gamep->arena));
+    if (gamep->hasLevel) {
+        // levelOpen() made sure there is room for the snake and food.
+        Level* levelp = &(gamep->level);
+        bool ok = setLevel(statep, levelp->wallsp, levelp->wrap, &(gamep->arena));
+        assert(ok);
+    }
+    newGame(gamep);
+    startupMark(startupp, STARTUP_GAME);
+}
+
+
+// Draw the first frame, before there is an atlas to draw it with: the
+// background, a plain square for each block of the snake and the food.  The
+// tiles replace it on the next frame, which is a full repaint.  It goes
+// through SDL, since whether the screen can be drawn on directly is only
+// known once the atlas is made.
+void drawFirstFrame(Game* gamep) {
+    State* statep = &(gamep->state);
+    Snake* snakep = playerSnake(statep);
+    bool directDraw = gamep->directDraw;
+    gamep->directDraw = false;
+    drawBG(gamep);
+    gamep->directDraw = directDraw;
+    SnakeNode block = *snakeHead(snakep);
+    uint32_t i = snakep->head;
+    for (uint32_t n = snakeLength(snakep); n > 0; n--) {
+        SDL_Rect cell = cellRect(gamep, block.x, block.y);
+        SDL_FillRect(gamep->screenp, &cell, gamep->snakeColor);
+        stepOnBoard(statep, &block, ringLink(&(snakep->ring), i));
+        i = ringNext(&(snakep->ring), i);
+    }
+    SDL_Rect food = cellRect(gamep, statep->food.x, statep->food.y);
+    SDL_FillRect(gamep->screenp, &food, gamep->foodColor);
+    SDL_Flip(gamep->screenp);
+    gamep->redrawAll = true;
+}
+
 
-    restart(statep);
+// Perform the initialization which can wait until the first frame is on the
+// screen.
+void initDeferred(Game* gamep) {
+    atlasInit(&(gamep->atlas), gamep->screenp, gamep->cellSize, gamep->bgColor, gamep->snakeColor, gamep->foodColor);
+    if (gamep->directDraw && (rasterSupports(gamep->screenp) == false || SDL_MUSTLOCK(gamep->atlas.surfacep))) {
+        fprintf(stderr, "can't draw directly on this screen: using SDL\n");
+        gamep->directDraw = false;
+    }
+    gamep->atlas.direct = gamep->directDraw;
+    if (gamep->incrementalDraw && gamep->pageFlipping) {
+        SDL_PixelFormat* formatp = gamep->screenp->format;
+        gamep->carryp = SDL_CreateRGBSurface(SDL_SWSURFACE, gamep->screenp->w, gamep->screenp->h,
+            formatp->BitsPerPixel, formatp->Rmask, formatp->Gmask, formatp->Bmask, formatp->Amask);
+        assert(gamep->carryp != NULL);
+    }
+    printf("renderer: %s\n", gamep->directDraw ? "direct" : "sdl");
+    startupMark(&(gamep->startup), STARTUP_ATLAS);
 }
 
 
 // The process entry point.
+// usage: snake [--video MODE] [--full-redraw] [--raster] [--board WxH] [--seed N] [--record FILE | --replay FILE]
+//              [--autopilot] [--autopilot-budget US]
+//              [--timing CSV] [--timing-overlay] [--pacing FILE]
+//              [--speed START,MIN,STEP] [--no-interpolation]
+//              [--snapshot FILE] [--scores FILE] [--demo FILE] [--telemetry HOST:PORT]
+//              [--level FILE]
 int main(int argc, char** argv) {
-    State state;
-    init(&state);
+    uint64_t startNs = timingNow();
+    Game game;
+    // zeroed, so that every option is off unless set below, and quitting
+    // before the game has started can't save stray scores over the real ones.
+    memset(&game, 0, sizeof(game));
+    startupInit(&(game.startup), startNs);
+    game.videoMode = "auto";
+    game.incrementalDraw = true;
+    game.speed.startMs = 200;
+    game.speed.minMs = 80;
+    game.speed.stepMs = 4;
+    game.interpolate = true;
+#ifdef BOARD_WIDTH
+    game.state.gridWidth = BOARD_WIDTH;
+    game.state.gridHeight = BOARD_HEIGHT;
+#else
+    game.state.gridWidth = 15;
+    game.state.gridHeight = 10;
+#endif
+    uint32_t autopilotBudgetUs = 2000;
+    uint32_t seed = time(NULL);
+    const char* recordPath = NULL;
+    const char* demoPath = NULL;
+    const char* telemetryAddress = NULL;
+    game.telemetry.fd = -1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) {
+            game.videoMode = argv[++i];
+        } else if (strcmp(argv[i], "--full-redraw") == 0) {
+            game.incrementalDraw = false;
+        } else if (strcmp(argv[i], "--raster") == 0) {
+            game.directDraw = true;
+        } else if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            unsigned int width;
+            unsigned int height;
+            if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 ||
+                width == 0 || height == 0 || width > SCREEN_WIDTH || height > SCREEN_HEIGHT) {
+                fprintf(stderr, "bad board size %s\n", argv[i]);
+                return 1;
+            }
+            game.state.gridWidth = width;
+            game.state.gridHeight = height;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            if (playerOpen(&(game.player), argv[++i]) == false) {
+                fprintf(stderr, "can't read replay %s\n", argv[i]);
+                return 1;
+            }
+            game.replaying = true;
+            seed = game.player.header.seed;
+        } else if (strcmp(argv[i], "--autopilot") == 0) {
+            game.autopiloting = true;
+        } else if (strcmp(argv[i], "--autopilot-budget") == 0 && i + 1 < argc) {
+            autopilotBudgetUs = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--timing") == 0 && i + 1 < argc) {
+            game.timingPath = argv[++i];
+        } else if (strcmp(argv[i], "--timing-overlay") == 0) {
+            game.timingOverlay = true;
+        } else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc) {
+            game.pacingPath = argv[++i];
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            SpeedCurve* speedp = &(game.speed);
+            if (sscanf(argv[++i], "%u,%u,%u", &(speedp->startMs), &(speedp->minMs), &(speedp->stepMs)) != 3 ||
+                speedp->minMs == 0 || speedp->minMs > speedp->startMs) {
+                fprintf(stderr, "bad speed curve %s\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--no-interpolation") == 0) {
+            game.interpolate = false;
+        } else if (strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc) {
+            game.snapshotPath = argv[++i];
+        } else if (strcmp(argv[i], "--scores") == 0 && i + 1 < argc) {
+            game.scoresPath = argv[++i];
+        } else if (strcmp(argv[i], "--demo") == 0 && i + 1 < argc) {
+            demoPath = argv[++i];
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetryAddress = argv[++i];
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            if (levelOpen(&(game.level), argv[++i]) == false) {
+                fprintf(stderr, "can't read level %s\n", argv[i]);
+                return 1;
+            }
+            game.hasLevel = true;
+        }
+    }
+    if (game.hasLevel) {
+        game.state.gridWidth = game.level.gridWidth;
+        game.state.gridHeight = game.level.gridHeight;
+    }
+    if (game.replaying) {
+        // like the seed, the board comes from the replay.
+        if (game.hasLevel && (game.level.gridWidth != game.player.header.gridWidth ||
+            game.level.gridHeight != game.player.header.gridHeight)) {
+            fprintf(stderr, "the replay is for another board than the level\n");
+            return 1;
+        }
+        game.state.gridWidth = game.player.header.gridWidth;
+        game.state.gridHeight = game.player.header.gridHeight;
+    }
+#ifdef BOARD_WIDTH
+    if (game.state.gridWidth != BOARD_WIDTH || game.state.gridHeight != BOARD_HEIGHT) {
+        fprintf(stderr, "this build only plays a %ux%u board\n", BOARD_WIDTH, BOARD_HEIGHT);
+        return 1;
+    }
+#endif
+    if (game.state.gridWidth == 0 || game.state.gridHeight == 0 || boardCellSize(&(game.state)) < MIN_CELL_SIZE) {
+        fprintf(stderr, "a %ux%u board doesn't fit the screen\n", game.state.gridWidth, game.state.gridHeight);
+        return 1;
+    }
+    timingInit(&(game.timing), game.timingPath != NULL || game.timingOverlay);
+    startupMark(&(game.startup), STARTUP_ARGS);
+    init(&game, seed);
+    drawFirstFrame(&game);
+    startupMark(&(game.startup), STARTUP_FRAME);
+
+    // everything from here on only has to be done before the first tick.
+    initDeferred(&game);
+    if (game.autopiloting) {
+        autopilotInit(&(game.autopilot), &(game.state), autopilotBudgetUs, &(game.arena));
+    }
+    if (recordPath != NULL && game.replaying == false) {
+        if (recorderOpen(&(game.recorder), recordPath, &(game.state), seed) == false) {
+            fprintf(stderr, "can't create replay %s\n", recordPath);
+            quit(&game, 1);
+        }
+        game.recording = true;
+    }
+    // a recording has to start from the seed, so it never resumes.
+    if (game.snapshotPath != NULL && game.replaying == false && game.recording == false) {
+        if (snapshotLoad(&(game.state), game.snapshotPath)) {
+            game.gameStartTick = game.state.tickCount;
+            game.redrawAll = true;
+            draw(&game);
+            printf("resumed at tick %u in %.2f ms\n", game.state.tickCount, (timingNow() - startNs) / 1e6);
+        } else {
+            // the attempt may have left a mess: start over from the seed.
+            seedRandom(&(game.state), seed);
+            newGame(&game);
+        }
+    }
+    if (game.scoresPath != NULL) {
+        Scores* scoresp = &(game.scores);
+        scoresLoad(scoresp, game.scoresPath);
+        printf("scores: %u games, best length %u, %llu ticks\n", scoresp->gamesPlayed, scoresp->bestLength,
+            (unsigned long long)scoresp->totalTicks);
+    }
+    // the demo takes over the state, which would throw a recording out.
+    if (demoPath != NULL && game.replaying == false && game.autopiloting == false && game.recording == false) {
+        Player* demop = &(game.demo);
+        if (playerOpen(demop, demoPath) == false) {
+            fprintf(stderr, "can't read demo %s\n", demoPath);
+        } else if (demop->header.gridWidth != game.state.gridWidth || demop->header.gridHeight != game.state.gridHeight) {
+            fprintf(stderr, "demo %s is for a %ux%u board\n", demoPath, demop->header.gridWidth, demop->header.gridHeight);
+            playerClose(demop);
+        } else {
+            game.hasDemo = true;
+        }
+    }
+    if (telemetryAddress != NULL && telemetryOpen(&(game.telemetry), telemetryAddress) == false) {
+        fprintf(stderr, "can't stream to %s\n", telemetryAddress);
+    }
+    startupMark(&(game.startup), STARTUP_FILES);
+    startupPrint(&(game.startup));
 
+    // from here on, nothing allocates.
+    arenaSeal(&(game.arena));
+
+    game.startTicks = SDL_GetTicks();
+    game.wakeups = 0;
+    game.lastFrame = game.startTicks;
+    uint32_t accumulator = 0;  // game time not yet simulated, in milliseconds.
+    bool wasIdle = false;
     while (true) {
-        uint32_t ticks = SDL_GetTicks();
-        uint32_t elapsed = ticks - state.lastFrame;
-        if (elapsed >= state.framePeriod) {
-            update(&state);
-            draw(&state);
-
-            if (elapsed > state.framePeriod * 2) {
-                // catch up.
-                state.lastFrame = ticks;
-            } else {
-                state.lastFrame += state.framePeriod;
+        if (isIdle(&game)) {
+            // finish showing the last change, then sleep until a key comes
+            // rather than waking up every frame to draw the same thing.  With
+            // nothing moving, this is also the time to save the stats.
+            draw(&game);
+            flushScores(&game);
+            if (wasIdle == false) {
+                // SDL 1.2 can't wait with a timeout, so a timer event ends
+                // the wait when it is time for the demo.
+                if (game.hasDemo && game.paused == false) {
+                    game.demoTimer = SDL_AddTimer(DEMO_IDLE_MS, demoTimerFired, NULL);
+                }
+                wasIdle = true;
             }
-        } else {
-            uint32_t remaining = state.framePeriod - elapsed;
-            SDL_Delay(remaining);
+            SDL_WaitEvent(NULL);
+            game.wakeups++;
+            handleEvents(&game);
+            telemetryTick(&(game.telemetry), &(game.state));
+            draw(&game);
+            game.lastFrame = SDL_GetTicks();
+            accumulator = 0;
+            pacingResume(&(game.pacing));
+            continue;
+        }
+        if (wasIdle) {
+            cancelDemoTimer(&game);
+            wasIdle = false;
+        }
+        uint32_t frameStart = SDL_GetTicks();
+        pacingFrame(&(game.pacing), timingNow());
+        accumulator += frameStart - game.lastFrame;
+        game.lastFrame = frameStart;
+
+        // run as many ticks as the time since the last frame is worth, at
+        // whatever rate the speed curve sets.
+        int ticks = 0;
+        while (accumulator >= tickPeriod(&game) && ticks < MAX_TICKS_PER_FRAME && isIdle(&game) == false) {
+            accumulator -= tickPeriod(&game);
+            update(&game);
+            telemetryTick(&(game.telemetry), &(game.state));
+            ticks++;
+        }
+        uint32_t period = tickPeriod(&game);
+        if (accumulator >= period) {
+            // too far behind to catch up without starving the renderer:
+            // drop the time, but keep count of it.  A game which stopped
+            // for a crash or a pause throws the time away anyway, and hasn't
+            // dropped anything.
+            if (ticks == MAX_TICKS_PER_FRAME) {
+                pacingDrop(&(game.pacing), accumulator / period);
+            }
+            accumulator %= period;
+        }
+        if (ticks == 0) {
+            handleEvents(&game);
+        } else if (ticks > 1) {
+            // the incremental renderer only knows about the last tick.
+            game.redrawAll = true;
+        }
+
+        if (game.interpolate) {
+            game.progress = 1 + accumulator * (game.cellSize - 1) / period;
+        }
+        draw(&game);
+
+        uint32_t spent = SDL_GetTicks() - frameStart;
+        if (spent < game.framePeriod) {
+            SDL_Delay(game.framePeriod - spent);
+            game.wakeups++;
         }
-        continue;
     }
 
     return 0;
@@ -0,0 +1,202 @@
+// Saving a game in progress, to resume it after the console is switched off.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "snapshot.h"
+
+#include <stdio.h>  // snprintf, rename
+#include <string.h>  // memcpy, memcmp
+#include <fcntl.h>  // open
+#include <unistd.h>  // write, fsync, close
+#include <sys/mman.h>  // mmap, munmap
+#include <sys/stat.h>  // fstat
+
+
+// Store a 16 bit value, little-endian.
+static void putU16(uint8_t* p, uint16_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+
+// Store a 32 bit value, little-endian.
+static void putU32(uint8_t* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+
+// Load a 16 bit value, little-endian.
+static uint16_t getU16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+
+// Load a 32 bit value, little-endian.
+static uint32_t getU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+// Write all of a buffer.  Returns false on error.
+static bool writeAll(int fd, const uint8_t* bufp, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, bufp, size);
+        if (n <= 0) {
+            return false;
+        }
+        bufp += n;
+        size -= n;
+    }
+    return true;
+}
+
+
+// Encode a game in progress into a buffer of capacity bytes.  Returns the
+// size of the snapshot, or 0 if it doesn't fit, or the board is too large for
+// its one byte sides.
+size_t snapshotEncode(State* statep, uint8_t* bufp, size_t capacity) {
+    assert(statep->crashed == false && statep->snakeCount == 1);
+    Snake* snakep = playerSnake(statep);
+#ifdef LARGE_BOARDS
+    if (statep->gridWidth > 255 || statep->gridHeight > 255) {
+        return 0;
+    }
+#endif
+    uint16_t length = coveredCells(statep);
+    size_t size = SNAPSHOT_HEADER_SIZE + (length + 2) / 4;
+    if (size > capacity) {
+        return 0;
+    }
+
+    memcpy(bufp, "SNKS", 4);
+    bufp[4] = SNAPSHOT_VERSION;
+    bufp[5] = statep->gridWidth;
+    bufp[6] = statep->gridHeight;
+    bufp[7] = snakep->direction;
+    putU16(bufp + 8, length);
+    bufp[10] = snakeHead(snakep)->x;
+    bufp[11] = snakeHead(snakep)->y;
+    bufp[12] = statep->food.x;
+    bufp[13] = statep->food.y;
+    bufp[14] = 0;
+    bufp[15] = 0;
+    putU32(bufp + 16, statep->rng);
+    putU32(bufp + 20, statep->tickCount);
+
+    uint8_t* linksp = bufp + SNAPSHOT_HEADER_SIZE;
+    memset(linksp, 0, size - SNAPSHOT_HEADER_SIZE);
+    // the same packing as the ring, but starting from the head.
+    Ring* ringp = &(snakep->ring);
+    uint32_t cursor = snakep->head;
+    for (uint16_t i = 0; i < length - 1; i++) {
+        linksp[i / 4] |= (ringLink(ringp, cursor) - 1) << (2 * (i % 4));
+        cursor = ringNext(ringp, cursor);
+    }
+    return size;
+}
+
+
+// Save a game in progress.  The file is written under a temporary name and
+// renamed over path, so a crash half way through leaves the old snapshot.
+// Returns false if it can't be written, or can't be encoded.
+bool snapshotSave(State* statep, const char* path) {
+    uint8_t buf[SNAPSHOT_MAX_SIZE];
+    size_t size = snapshotEncode(statep, buf, sizeof(buf));
+    if (size == 0) {
+        return false;
+    }
+
+    char tmpPath[256];
+    int len = snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    if (len < 0 || (size_t)len >= sizeof(tmpPath)) {
+        return false;
+    }
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    // the data must be on disk before the rename makes it the snapshot.
+    bool ok = writeAll(fd, buf, size) && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (ok == false || rename(tmpPath, path) != 0) {
+        unlink(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+
+// Unpack the header and body of a snapshot into statep.
+static bool snapshotDecode(State* statep, const uint8_t* datap, size_t size) {
+    if (size < SNAPSHOT_HEADER_SIZE || memcmp(datap, "SNKS", 4) != 0 || datap[4] != SNAPSHOT_VERSION) {
+        return false;
+    }
+    if (datap[5] != statep->gridWidth || datap[6] != statep->gridHeight || statep->snakeCount != 1) {
+        return false;
+    }
+    uint8_t direction = datap[7];
+    uint16_t length = getU16(datap + 8);
+    uint32_t rng = getU32(datap + 16);
+    if (direction < UP || direction > LEFT || length == 0 || rng == 0 ||
+        length > statep->gridWidth * statep->gridHeight ||
+        size < SNAPSHOT_HEADER_SIZE + (size_t)(length + 2) / 4) {
+        return false;
+    }
+
+    // copy the links to the start of the ring, and lay the body out along
+    // them.
+    const uint8_t* linksp = datap + SNAPSHOT_HEADER_SIZE;
+    Snake* snakep = playerSnake(statep);
+    for (uint16_t i = 0; i < length - 1; i++) {
+        ringSetLink(&(snakep->ring), i, ((linksp[i / 4] >> (2 * (i % 4))) & 3) + 1);
+    }
+    snakep->headNode.x = datap[10];
+    snakep->headNode.y = datap[11];
+    Cell lengths[1] = {length};
+    if (placeSnakes(statep, lengths) == false) {
+        return false;
+    }
+
+    Food food = {datap[12], datap[13]};
+    if (food.x >= statep->gridWidth || food.y >= statep->gridHeight || isOccupied(statep, food.x, food.y)) {
+        return false;
+    }
+    statep->food = food;
+    snakep->direction = direction;
+    statep->rng = rng;
+    statep->tickCount = getU32(datap + 20);
+    return true;
+}
+
+
+// Resume a saved game into a state set up by initGame().  Returns false if
+// there is no snapshot, or it doesn't fit this board; statep is then left
+// for restart() to reset.
+bool snapshotLoad(State* statep, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < SNAPSHOT_HEADER_SIZE) {
+        close(fd);
+        return false;
+    }
+    // map it rather than read it: the whole file is decoded in one pass.
+    void* datap = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (datap == MAP_FAILED) {
+        return false;
+    }
+    bool ok = snapshotDecode(statep, datap, st.st_size);
+    munmap(datap, st.st_size);
+    return ok;
+}
@@ -0,0 +1,55 @@
+// Saving a game in progress, to resume it after the console is switched off.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// A snapshot file is a 24 byte header followed by the body of the snake as a
+// stream of 2 bit links.  All multi-byte fields are little-endian.
+//
+//   header: "SNKS", version, gridWidth, gridHeight, direction,
+//           length (2), headX, headY, foodX, foodY, 0, 0,
+//           rng (4), tickCount (4)
+//   links:  length - 1 times (direction - 1), four to a byte, lowest bits
+//           first: the way from each block to the next one towards the tail.
+//
+// Only a single player game in progress is saved, on a board of up to 255
+// cells a side.  Everything else is rebuilt from the snake itself, so a
+// snapshot of the starting board is 24 bytes, and a full 15x10 board is 62.
+// The order of the free cell set is not saved, so the food after a resume
+// follows the snapshot rather than the original seed: a snapshot always
+// resumes the same way, but not as the game would have gone on without the
+// break.
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "engine.h"
+
+#include <stdbool.h>  // bool
+#include <stddef.h>  // size_t
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 24
+#define SNAPSHOT_MAX_SIZE (SNAPSHOT_HEADER_SIZE + (255 * 255 + 3) / 4)
+
+
+// Encode a game in progress into a buffer of capacity bytes.  Returns the
+// size of the snapshot, or 0 if it doesn't fit, or the board is too large for
+// its one byte sides.
+size_t snapshotEncode(State* statep, uint8_t* bufp, size_t capacity);
+
+// Save a game in progress.  The file is written under a temporary name and
+// renamed over path, so a crash half way through leaves the old snapshot.
+// Returns false if it can't be written, or can't be encoded.
+bool snapshotSave(State* statep, const char* path);
+
+// Resume a saved game into a state set up by initGame().  Returns false if
+// there is no snapshot, or it doesn't fit this board; statep is then left
+// for restart() to reset.
+bool snapshotLoad(State* statep, const char* path);
+
+#endif
@@ -0,0 +1,179 @@
+// Streaming a game in progress over UDP, for watching it from a desktop.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "telemetry.h"
+#include "snapshot.h"
+
+#include <stdio.h>  // sscanf
+#include <string.h>  // memset
+#include <fcntl.h>  // fcntl
+#include <unistd.h>  // close
+#include <sys/socket.h>  // socket, connect, send
+#include <netinet/in.h>  // sockaddr_in
+#include <arpa/inet.h>  // inet_pton, htons
+
+
+// Start streaming to address, an IPv4 "a.b.c.d:port".  Returns false if the
+// address is bad or the socket can't be made; telemetryTick() then does
+// nothing.
+bool telemetryOpen(Telemetry* telemetryp, const char* address) {
+    memset(telemetryp, 0, sizeof(*telemetryp));
+    telemetryp->fd = -1;
+    char host[64];
+    unsigned int port;
+    if (sscanf(address, "%63[0-9.]:%u", host, &port) != 2 || port == 0 || port > 65535) {
+        return false;
+    }
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &(to.sin_addr)) != 1) {
+        return false;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    // connected, so that every send is a plain send(), and non-blocking, so
+    // that none of them ever waits for the socket.
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0 ||
+        connect(fd, (struct sockaddr*)&to, sizeof(to)) != 0) {
+        close(fd);
+        return false;
+    }
+    telemetryp->fd = fd;
+    return true;
+}
+
+
+// Send the first size bytes of the buffer.  A datagram which can't go at once
+// is dropped, and the viewer is then out of step until the next keyframe.
+static void sendPacket(Telemetry* telemetryp, size_t size) {
+    if (send(telemetryp->fd, telemetryp->buf, size, MSG_DONTWAIT) != (ssize_t)size) {
+        telemetryp->dropped++;
+        telemetryp->synced = false;
+        telemetryp->backingOff = true;
+        telemetryp->sinceKeyframe = 0;
+        return;
+    }
+    telemetryp->packets++;
+    telemetryp->bytes += size;
+}
+
+
+// Remember the state the viewer now has.
+static void noteSent(Telemetry* telemetryp, State* statep, Cell length) {
+    telemetryp->lastTick = statep->tickCount;
+    telemetryp->lastHead = *snakeHead(playerSnake(statep));
+    telemetryp->lastFood = statep->food;
+    telemetryp->lastLength = length;
+    telemetryp->lastCrashed = statep->crashed;
+}
+
+
+// Send the whole game.  Returns false if it can't be sent as a keyframe: the
+// game is over, or the snake is too long for one datagram.
+static bool sendKeyframe(Telemetry* telemetryp, State* statep, Cell length) {
+    if (statep->crashed) {
+        return false;
+    }
+    uint8_t* bufp = telemetryp->buf;
+    size_t size = snapshotEncode(statep, bufp + 1, TELEMETRY_MAX_PACKET - 1);
+    if (size == 0) {
+        return false;
+    }
+    bufp[0] = TELEMETRY_KEYFRAME;
+    telemetryp->synced = true;
+    telemetryp->sinceKeyframe = 0;
+    telemetryp->keyframes++;
+    sendPacket(telemetryp, size + 1);
+    noteSent(telemetryp, statep, length);
+    return true;
+}
+
+
+// Send what changed since the last call.  Call after every tick, and after
+// anything else which changes the state.  Does nothing if the stream is not
+// open.
+void telemetryTick(Telemetry* telemetryp, State* statep) {
+    if (telemetryp->fd < 0) {
+        return;
+    }
+    if (telemetryp->backingOff) {
+        if (++telemetryp->sinceKeyframe < TELEMETRY_KEYFRAME_INTERVAL) {
+            return;
+        }
+        telemetryp->backingOff = false;
+    }
+    Cell length = coveredCells(statep);
+    SnakeNode head = *snakeHead(playerSnake(statep));
+    Food food = statep->food;
+    bool foodMoved = food.x != telemetryp->lastFood.x || food.y != telemetryp->lastFood.y;
+    bool headMoved = head.x != telemetryp->lastHead.x || head.y != telemetryp->lastHead.y;
+    if (telemetryp->synced && statep->tickCount == telemetryp->lastTick && foodMoved == false &&
+        headMoved == false && length == telemetryp->lastLength && statep->crashed == telemetryp->lastCrashed) {
+        // nothing happened: paused, or waiting for a key.
+        return;
+    }
+
+    // a delta only follows on from one tick to the next, in the same game.
+    bool grew = length == telemetryp->lastLength + 1;
+    // a step may go off one edge and come back on at the other.
+    bool step = false;
+    for (uint8_t direction = UP; direction <= LEFT; direction++) {
+        SnakeNode next = telemetryp->lastHead;
+        stepOnBoard(statep, &next, direction);
+        step = step || (next.x == head.x && next.y == head.y);
+    }
+    bool deltaFits = telemetryp->synced && telemetryp->lastCrashed == false &&
+        statep->tickCount == telemetryp->lastTick + 1 &&
+        ((step && (grew || length == telemetryp->lastLength)) || statep->crashed);
+    telemetryp->sinceKeyframe++;
+    if (deltaFits == false || telemetryp->sinceKeyframe >= TELEMETRY_KEYFRAME_INTERVAL) {
+        if (sendKeyframe(telemetryp, statep, length)) {
+            return;
+        }
+        if (deltaFits == false) {
+            // nothing the viewer could follow on from: wait for a keyframe.
+            telemetryp->synced = false;
+            return;
+        }
+    }
+
+    uint8_t* bufp = telemetryp->buf;
+    size_t size = 5;
+    bufp[0] = 0;
+    if (statep->crashed) {
+        bufp[0] |= TELEMETRY_CRASHED;
+    } else if (grew) {
+        bufp[0] |= TELEMETRY_GREW;
+    }
+    bufp[1] = statep->tickCount;
+    bufp[2] = statep->tickCount >> 8;
+    bufp[3] = head.x;
+    bufp[4] = head.y;
+    if (foodMoved) {
+        bufp[0] |= TELEMETRY_FOOD;
+        bufp[5] = food.x;
+        bufp[6] = food.y;
+        size = 7;
+    }
+    sendPacket(telemetryp, size);
+    noteSent(telemetryp, statep, length);
+}
+
+
+// Stop streaming.
+void telemetryClose(Telemetry* telemetryp) {
+    if (telemetryp->fd >= 0) {
+        close(telemetryp->fd);
+        telemetryp->fd = -1;
+    }
+}
@@ -0,0 +1,81 @@
+// Streaming a game in progress over UDP, for watching it from a desktop.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// One datagram is sent per tick: a delta from the tick before, or a
+// keyframe to join the stream from.  All multi-byte fields are
+// little-endian.
+//
+//   delta:    flags, tick (2), headX, headY, [foodX, foodY]
+//   keyframe: 0x80, snapshot (see snapshot.h)
+//
+// The flags of a delta say whether the snake grew (TELEMETRY_GREW: the
+// tail stayed put), whether the food moved (TELEMETRY_FOOD: its new cell
+// follows) and whether the snake crashed (TELEMETRY_CRASHED).  The tick is
+// the low 16 bits of the tick count after the move, so a viewer can tell
+// when it has missed one and wait for the next keyframe.  A delta is 5
+// bytes, or 7 when the food moves.
+//
+// A keyframe goes out every TELEMETRY_KEYFRAME_INTERVAL ticks, and in place
+// of any change a delta can't express: a restart, a resumed snapshot, a
+// replay going back to tick 0, or a send which failed.  Sends never wait: a
+// datagram the socket can't take at once is dropped and counted, and
+// nothing more is sent until the next keyframe is due, so a stream nobody
+// is listening to costs one datagram per keyframe interval.
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "engine.h"
+
+#include <stdint.h>  // uint8_t
+#include <stdbool.h>  // bool
+
+#define TELEMETRY_KEYFRAME 0x80
+#define TELEMETRY_GREW 0x01
+#define TELEMETRY_FOOD 0x02
+#define TELEMETRY_CRASHED 0x04
+#define TELEMETRY_KEYFRAME_INTERVAL 32  // ticks between keyframes.
+#define TELEMETRY_MAX_PACKET 1400  // within the MTU of any network on the way.
+
+
+// The stream, and what the viewer was last sent.
+struct _Telemetry {
+    int fd;  // -1 when not streaming.
+    bool synced;  // the viewer has everything up to lastTick.
+    uint32_t lastTick;
+    SnakeNode lastHead;
+    Food lastFood;
+    Cell lastLength;
+    bool lastCrashed;
+    uint32_t sinceKeyframe;  // ticks since the last keyframe.
+    bool backingOff;  // a send failed: nobody may be listening.
+
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t keyframes;
+    uint64_t dropped;  // datagrams the socket wouldn't take.
+    uint8_t buf[TELEMETRY_MAX_PACKET];
+};
+typedef struct _Telemetry Telemetry;
+
+
+// Start streaming to address, an IPv4 "a.b.c.d:port".  Returns false if the
+// address is bad or the socket can't be made; telemetryTick() then does
+// nothing.
+bool telemetryOpen(Telemetry* telemetryp, const char* address);
+
+// Send whatever changed since the last call.  Call after every tick, and
+// after anything else which changes the state.  Does nothing if the stream
+// is not open.
+void telemetryTick(Telemetry* telemetryp, State* statep);
+
+// Stop streaming.
+void telemetryClose(Telemetry* telemetryp);
+
+#endif
@@ -0,0 +1,179 @@
+// The tile atlas: every picture the board is drawn with, pre-rendered once.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "tiles.h"
+#include "engine.h"
+#include "raster.h"
+
+#include <assert.h>  // assert
+
+
+// Return the area of the atlas holding a tile.
+static SDL_Rect tileRect(Atlas* atlasp, uint8_t tile) {
+    uint8_t cellSize = atlasCellSize(atlasp);
+    SDL_Rect rect = {tile * cellSize, 0, cellSize, cellSize};
+    return rect;
+}
+
+
+// Draw a block of the snake: the cell inset by one pixel, plus a one pixel
+// strip along every side which links to a neighbouring block, so that the
+// blocks of the snake join up.
+static void renderBlock(Atlas* atlasp, uint8_t tile, uint8_t links, uint32_t bgColor, uint32_t snakeColor) {
+    SDL_Surface* surfacep = atlasp->surfacep;
+    SDL_Rect cell = tileRect(atlasp, tile);
+    SDL_FillRect(surfacep, &cell, bgColor);
+    SDL_Rect rect = {cell.x + 1, cell.y + 1, cell.w - 2, cell.h - 2};
+    SDL_FillRect(surfacep, &rect, snakeColor);
+    for (uint8_t direction = UP; direction <= LEFT; direction++) {
+        if ((links & TILE_LINK(direction)) == 0) {
+            continue;
+        }
+        SDL_Rect link = {cell.x + 1, cell.y + 1, cell.w - 2, cell.h - 2};
+        switch (direction) {
+            case RIGHT:
+                link.x = cell.x + cell.w - 1;
+                link.w = 1;
+                break;
+            case LEFT:
+                link.x = cell.x;
+                link.w = 1;
+                break;
+            case DOWN:
+                link.y = cell.y + cell.h - 1;
+                link.h = 1;
+                break;
+            case UP:
+                link.y = cell.y;
+                link.h = 1;
+                break;
+            default:
+                unreachable;
+        }
+        SDL_FillRect(surfacep, &link, snakeColor);
+    }
+}
+
+
+// Render every tile into a surface in the same format as the screen.  The
+// colors must already be mapped for the screen.  Tiles are blitted with SDL
+// until direct is set.
+void atlasInit(Atlas* atlasp, SDL_Surface* screenp, uint8_t cellSize,
+    uint32_t bgColor, uint32_t snakeColor, uint32_t foodColor) {
+    SDL_PixelFormat* formatp = screenp->format;
+    SDL_Surface* surfacep = SDL_CreateRGBSurface(SDL_SWSURFACE, TILE_COUNT * cellSize, cellSize,
+        formatp->BitsPerPixel, formatp->Rmask, formatp->Gmask, formatp->Bmask, formatp->Amask);
+    assert(surfacep != NULL);
+    // make sure blits from the atlas never need converting.
+    atlasp->surfacep = SDL_DisplayFormat(surfacep);
+    assert(atlasp->surfacep != NULL);
+    SDL_FreeSurface(surfacep);
+    atlasp->cellSize = cellSize;
+    atlasp->direct = false;
+    // a build for one cell size draws no other.
+    assert(cellSize == atlasCellSize(atlasp));
+
+    for (uint8_t links = 0; links < 16; links++) {
+        renderBlock(atlasp, TILE_BODY + links, links, bgColor, snakeColor);
+    }
+    renderBlock(atlasp, TILE_HEAD, 0, bgColor, snakeColor);
+    renderBlock(atlasp, TILE_TAIL, 0, bgColor, snakeColor);
+    for (uint8_t direction = UP; direction <= LEFT; direction++) {
+        renderBlock(atlasp, TILE_HEAD + direction, TILE_LINK(direction), bgColor, snakeColor);
+        renderBlock(atlasp, TILE_TAIL + direction, TILE_LINK(direction), bgColor, snakeColor);
+    }
+    SDL_Rect food = tileRect(atlasp, TILE_FOOD);
+    SDL_FillRect(atlasp->surfacep, &food, foodColor);
+}
+
+
+// Copy a tile onto the screen, at the top left corner of rect.
+void atlasBlit(Atlas* atlasp, uint8_t tile, SDL_Surface* screenp, SDL_Rect rect) {
+    SDL_Rect source = tileRect(atlasp, tile);
+    if (atlasp->direct) {
+        rasterCopy(atlasp->surfacep, source, screenp, rect.x, rect.y);
+        return;
+    }
+    SDL_BlitSurface(atlasp->surfacep, &source, screenp, &rect);
+}
+
+
+// Copy only the strip of a tile within depth pixels of one side, to the same
+// place on the screen as atlasBlit() would.
+void atlasBlitEdge(Atlas* atlasp, uint8_t tile, uint8_t side, uint8_t depth, SDL_Surface* screenp, SDL_Rect rect) {
+    if (depth == 0) {
+        return;
+    }
+    SDL_Rect source = tileRect(atlasp, tile);
+    uint8_t cellSize = atlasCellSize(atlasp);
+    switch (side) {
+        case RIGHT:
+            source.x += cellSize - depth;
+            rect.x += cellSize - depth;
+            source.w = depth;
+            break;
+        case LEFT:
+            source.w = depth;
+            break;
+        case DOWN:
+            source.y += cellSize - depth;
+            rect.y += cellSize - depth;
+            source.h = depth;
+            break;
+        case UP:
+            source.h = depth;
+            break;
+        default:
+            unreachable;
+    }
+    if (atlasp->direct) {
+        rasterCopy(atlasp->surfacep, source, screenp, rect.x, rect.y);
+        return;
+    }
+    SDL_BlitSurface(atlasp->surfacep, &source, screenp, &rect);
+}
+
+
+// Pick the tile for the block at ring index i, from the links either side
+// of it.
+uint8_t snakeTile(Snake* snakep, uint32_t i) {
+    Ring* ringp = &(snakep->ring);
+    uint8_t towardsHead = 0;
+    uint8_t towardsTail = 0;
+    if (i != snakep->head) {
+        towardsHead = reverseDirection(ringLink(ringp, ringPrev(ringp, i)));
+    }
+    if (i != snakep->tail) {
+        towardsTail = ringLink(ringp, i);
+    }
+    if (i == snakep->head) {
+        return TILE_HEAD + towardsTail;
+    }
+    if (i == snakep->tail) {
+        return TILE_TAIL + towardsHead;
+    }
+    return TILE_BODY + (TILE_LINK(towardsHead) | TILE_LINK(towardsTail));
+}
+
+
+// Draw a whole snake on the board of statep, one tile per block, following
+// the links from the head.  The board's top left corner is at originX,
+// originY on the screen.
+void atlasDrawSnake(Atlas* atlasp, State* statep, Snake* snakep, SDL_Surface* screenp, int16_t originX, int16_t originY) {
+    uint8_t cellSize = atlasCellSize(atlasp);
+    Ring* ringp = &(snakep->ring);
+    SnakeNode block = *snakeHead(snakep);
+    uint32_t i = snakep->head;
+    for (uint32_t n = snakeLength(snakep); n > 0; n--) {
+        SDL_Rect cell = {originX + block.x * cellSize, originY + block.y * cellSize, cellSize, cellSize};
+        atlasBlit(atlasp, snakeTile(snakep, i), screenp, cell);
+        stepOnBoard(statep, &block, ringLink(ringp, i));
+        i = ringNext(ringp, i);
+    }
+}
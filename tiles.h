@@ -0,0 +1,89 @@
+// The tile atlas: every picture the board is drawn with, pre-rendered once.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// The atlas is a single row of cell sized tiles in the display format, so that
+// drawing a block of the snake or the food is one blit with no conversion.
+// The body tiles are indexed by which sides link to a neighbouring block; the
+// head and tail tiles by the side which links to the rest of the snake (0 for
+// a snake of one block).  The head and tail have tiles of their own so that a
+// theme can draw them differently, at no extra cost per frame.
+
+#ifndef TILES_H
+#define TILES_H
+
+#include "engine.h"
+
+#include <stdint.h>  // uint8_t, int16_t, uint32_t
+#include <stdbool.h>  // bool
+
+#ifdef __APPLE__
+#include <SDL.h>
+#else
+#include <SDL/SDL.h>
+#endif
+
+#define TILE_LINK(direction) (1 << ((direction) - 1))  // a side of a body tile.
+#define TILE_BODY 0  // plus the TILE_LINK() of both linked sides.
+#define TILE_HEAD 16  // plus the direction of the linked side.
+#define TILE_TAIL 21  // plus the direction of the linked side.
+#define TILE_FOOD 26
+#define TILE_COUNT 27
+
+// Tiles are as large as the cells of the board, set at runtime.  Build with
+// -DCELL_SIZE=N to fix them at N pixels instead: atlasCellSize() is then a
+// constant, so a block's place on the screen takes no load, and with the
+// usual 16 pixel cells no multiply either, only shifts.
+#if defined(CELL_SIZE) && (CELL_SIZE < 1 || CELL_SIZE > 255)
+#error "CELL_SIZE must be from 1 to 255"
+#endif
+
+
+// The pre-rendered tiles.
+struct _Atlas {
+    SDL_Surface* surfacep;
+    uint8_t cellSize;
+    bool direct;  // copy tiles with rasterCopy(): the screen must be locked.
+};
+typedef struct _Atlas Atlas;
+
+
+// Return the size of a tile: a constant in a build for one cell size.
+static inline uint8_t atlasCellSize(Atlas* atlasp) {
+#ifdef CELL_SIZE
+    (void)atlasp;
+    return CELL_SIZE;
+#else
+    return atlasp->cellSize;
+#endif
+}
+
+
+// Render every tile into a surface in the same format as the screen.  The
+// colors must already be mapped for the screen.  Tiles are blitted with SDL
+// until direct is set.
+void atlasInit(Atlas* atlasp, SDL_Surface* screenp, uint8_t cellSize,
+    uint32_t bgColor, uint32_t snakeColor, uint32_t foodColor);
+
+// Copy a tile onto the screen, at the top left corner of rect.
+void atlasBlit(Atlas* atlasp, uint8_t tile, SDL_Surface* screenp, SDL_Rect rect);
+
+// Copy only the strip of a tile within depth pixels of one side, to the same
+// place on the screen as atlasBlit() would.
+void atlasBlitEdge(Atlas* atlasp, uint8_t tile, uint8_t side, uint8_t depth, SDL_Surface* screenp, SDL_Rect rect);
+
+// Pick the tile for the block at ring index i, from the links either side
+// of it.
+uint8_t snakeTile(Snake* snakep, uint32_t i);
+
+// Draw a whole snake on the board of statep, one tile per block, following
+// the links from the head.  The board's top left corner is at originX,
+// originY on the screen.
+void atlasDrawSnake(Atlas* atlasp, State* statep, Snake* snakep, SDL_Surface* screenp, int16_t originX, int16_t originY);
+
+#endif
@@ -0,0 +1,251 @@
+// Frame timing instrumentation: per-phase histograms of how long each part of
+// a frame takes.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+#include "timing.h"
+
+#include <stdio.h>  // fopen, fprintf, printf
+#include <string.h>  // memset
+#include <time.h>  // clock_gettime
+
+#define SUB_BUCKET_BITS 3
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+
+
+const char* phaseNames[PHASE_COUNT] = {"input", "move", "bg", "snake", "food", "flip", "lag"};
+const char* startupNames[STARTUP_COUNT] = {"args", "sdl", "video", "colors", "game", "frame", "atlas", "files"};
+
+
+// Return the nanoseconds elapsed since an arbitrary point.
+uint64_t timingNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// Return the bucket a duration falls into.
+static int bucketIndex(uint64_t ns) {
+    if (ns < 2 * SUB_BUCKETS) {
+        return ns;
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - SUB_BUCKET_BITS;
+    int index = (shift + 1) * SUB_BUCKETS + ((ns >> shift) & (SUB_BUCKETS - 1));
+    if (index >= HISTOGRAM_BUCKETS) {
+        index = HISTOGRAM_BUCKETS - 1;
+    }
+    return index;
+}
+
+
+// Return the smallest duration which falls into a bucket.
+static uint64_t bucketStart(int index) {
+    if (index < 2 * SUB_BUCKETS) {
+        return index;
+    }
+    int shift = index / SUB_BUCKETS - 1;
+    return (uint64_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+
+// Reset a histogram.
+void histogramInit(Histogram* histogramp) {
+    memset(histogramp, 0, sizeof(*histogramp));
+    histogramp->minNs = UINT64_MAX;
+}
+
+
+// Add a sample to a histogram.
+void histogramAdd(Histogram* histogramp, uint64_t ns) {
+    histogramp->count++;
+    histogramp->totalNs += ns;
+    if (ns < histogramp->minNs) {
+        histogramp->minNs = ns;
+    }
+    if (ns > histogramp->maxNs) {
+        histogramp->maxNs = ns;
+    }
+    histogramp->buckets[bucketIndex(ns)]++;
+}
+
+
+// Return the duration below which the given fraction of samples fall.
+uint64_t histogramPercentile(Histogram* histogramp, double fraction) {
+    if (histogramp->count == 0) {
+        return 0;
+    }
+    uint64_t wanted = fraction * histogramp->count;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogramp->buckets[i];
+        if (seen > wanted) {
+            // the top of the bucket, but never beyond what was seen.
+            uint64_t top = bucketStart(i + 1) - 1;
+            return top < histogramp->maxNs ? top : histogramp->maxNs;
+        }
+    }
+    return histogramp->maxNs;
+}
+
+
+// Reset all the histograms.  Nothing is recorded unless enabled.
+void timingInit(Timing* timingp, bool enabled) {
+    timingp->enabled = enabled;
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        histogramInit(&(timingp->phases[i]));
+    }
+}
+
+
+// Start timing a phase.  Returns the start time to pass to timingStop().
+uint64_t timingStart(Timing* timingp) {
+    if (timingp->enabled == false) {
+        return 0;
+    }
+    return timingNow();
+}
+
+
+// Record the time spent in a phase since timingStart().
+void timingStop(Timing* timingp, int phase, uint64_t startNs) {
+    if (timingp->enabled == false) {
+        return;
+    }
+    histogramAdd(&(timingp->phases[phase]), timingNow() - startNs);
+}
+
+
+// Write min/avg/percentiles/max of every phase to a CSV file.  Returns false
+// if the file can't be written.
+bool timingWriteCsv(Timing* timingp, const char* path) {
+    FILE* filep = fopen(path, "w");
+    if (filep == NULL) {
+        return false;
+    }
+    fprintf(filep, "phase,count,min_ns,avg_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        Histogram* histogramp = &(timingp->phases[i]);
+        uint64_t count = histogramp->count;
+        fprintf(filep, "%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+            phaseNames[i],
+            (unsigned long long)count,
+            (unsigned long long)(count ? histogramp->minNs : 0),
+            (unsigned long long)(count ? histogramp->totalNs / count : 0),
+            (unsigned long long)histogramPercentile(histogramp, 0.5),
+            (unsigned long long)histogramPercentile(histogramp, 0.9),
+            (unsigned long long)histogramPercentile(histogramp, 0.99),
+            (unsigned long long)histogramp->maxNs);
+    }
+    return fclose(filep) == 0;
+}
+
+
+// Start timing startup, from startNs.
+void startupInit(Startup* startupp, uint64_t startNs) {
+    memset(startupp, 0, sizeof(*startupp));
+    startupp->startNs = startNs;
+    startupp->lastNs = startNs;
+}
+
+
+// Record that a stage of startup has just ended.
+void startupMark(Startup* startupp, int stage) {
+    uint64_t nowNs = timingNow();
+    startupp->stageNs[stage] += nowNs - startupp->lastNs;
+    startupp->lastNs = nowNs;
+}
+
+
+// Print the time of every stage, and the time from main() to the first
+// frame.
+void startupPrint(Startup* startupp) {
+    uint64_t firstFrameNs = 0;
+    for (int i = 0; i < STARTUP_FIRST_FRAME; i++) {
+        firstFrameNs += startupp->stageNs[i];
+    }
+    printf("startup: first frame after %.2f ms (", firstFrameNs / 1e6);
+    for (int i = 0; i < STARTUP_COUNT; i++) {
+        const char* separatorp = i == 0 ? "" : i == STARTUP_FIRST_FRAME ? "), then " : ", ";
+        printf("%s%s %.2f", separatorp, startupNames[i], startupp->stageNs[i] / 1e6);
+    }
+    printf(" ms\n");
+}
+
+
+// Start measuring the pacing of frames due every framePeriodMs.
+void pacingInit(Pacing* pacingp, uint32_t framePeriodMs) {
+    memset(pacingp, 0, sizeof(*pacingp));
+    pacingp->framePeriodMs = framePeriodMs;
+    histogramInit(&(pacingp->intervals));
+}
+
+
+// Record that a frame has started at nowNs.
+void pacingFrame(Pacing* pacingp, uint64_t nowNs) {
+    if (pacingp->lastNs != 0) {
+        uint64_t intervalNs = nowNs - pacingp->lastNs;
+        histogramAdd(&(pacingp->intervals), intervalNs);
+        if (intervalNs > pacingp->framePeriodMs * 1500000ull) {
+            pacingp->lateFrames++;
+        }
+    }
+    pacingp->lastNs = nowNs;
+}
+
+
+// Forget the last frame, after waiting on purpose: the next interval would
+// not be a stall.
+void pacingResume(Pacing* pacingp) {
+    pacingp->lastNs = 0;
+}
+
+
+// Record that ticks were given up.
+void pacingDrop(Pacing* pacingp, uint32_t ticks) {
+    pacingp->droppedTicks += ticks;
+}
+
+
+// Print one line of totals.
+void pacingPrint(Pacing* pacingp) {
+    printf("pacing: %llu frames, %u late, %u ticks dropped, largest stall %.1f ms\n",
+        (unsigned long long)pacingp->intervals.count, pacingp->lateFrames, pacingp->droppedTicks,
+        pacingp->intervals.maxNs / 1e6);
+}
+
+
+// Write the totals and the histogram of intervals to a text file.  Returns
+// false if the file can't be written.
+bool pacingWrite(Pacing* pacingp, const char* path) {
+    FILE* filep = fopen(path, "w");
+    if (filep == NULL) {
+        return false;
+    }
+    Histogram* histogramp = &(pacingp->intervals);
+    uint64_t count = histogramp->count;
+    fprintf(filep, "frame period: %u ms\n", pacingp->framePeriodMs);
+    fprintf(filep, "intervals: %llu\n", (unsigned long long)count);
+    fprintf(filep, "late frames: %u (over %.1f ms)\n", pacingp->lateFrames, pacingp->framePeriodMs * 1.5);
+    fprintf(filep, "dropped ticks: %u\n", pacingp->droppedTicks);
+    fprintf(filep, "largest stall: %.3f ms\n", histogramp->maxNs / 1e6);
+    fprintf(filep, "interval ms: min %.3f, avg %.3f, p50 %.3f, p99 %.3f\n",
+        (count ? histogramp->minNs : 0) / 1e6, (count ? histogramp->totalNs / count : 0) / 1e6,
+        histogramPercentile(histogramp, 0.5) / 1e6, histogramPercentile(histogramp, 0.99) / 1e6);
+    // only the buckets anything fell into, each from its first nanosecond
+    // to its last.
+    fprintf(filep, "from_ns,to_ns,count\n");
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (histogramp->buckets[i] != 0) {
+            fprintf(filep, "%llu,%llu,%u\n", (unsigned long long)bucketStart(i),
+                (unsigned long long)(bucketStart(i + 1) - 1), histogramp->buckets[i]);
+        }
+    }
+    return fclose(filep) == 0;
+}
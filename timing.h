@@ -0,0 +1,150 @@
+// Frame timing instrumentation: per-phase histograms of how long each part of
+// a frame takes.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// The histograms are fixed size and live inside Timing, so recording a sample
+// never allocates.  Buckets are log-linear: exact below 16 ns, then eight
+// buckets per power of two, which keeps every percentile within 12.5%.
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>  // uint64_t
+#include <stdbool.h>  // bool
+
+#define PHASE_INPUT 0  // polling and handling events in update().
+#define PHASE_MOVE 1  // moveSnake() (or the replay step).
+#define PHASE_BG 2  // drawBG().
+#define PHASE_SNAKE 3  // drawSnake(), or the changed snake cells.
+#define PHASE_FOOD 4  // drawFood().
+#define PHASE_FLIP 5  // SDL_Flip(), or SDL_UpdateRects().
+#define PHASE_LAG 6  // from reading a turn key to the move which applies it.
+#define PHASE_COUNT 7
+
+#define HISTOGRAM_BUCKETS 256
+
+// the stages of startup, in the order they run.  Those before
+// STARTUP_FIRST_FRAME lead up to the first frame, the rest are put off until
+// it is on the screen.
+#define STARTUP_ARGS 0  // from main() through the options, a replay included.
+#define STARTUP_SDL 1  // SDL_Init().
+#define STARTUP_VIDEO 2  // opening the screen.
+#define STARTUP_COLORS 3  // mapping the colors to the screen format.
+#define STARTUP_GAME 4  // the arena, initGame() and the first restart().
+#define STARTUP_FRAME 5  // drawing and flipping the first frame.
+#define STARTUP_FIRST_FRAME 6
+#define STARTUP_ATLAS 6  // building the tile atlas.
+#define STARTUP_FILES 7  // the autopilot and every file or socket the game uses.
+#define STARTUP_COUNT 8
+
+
+// A histogram of durations, in nanoseconds.
+struct _Histogram {
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t minNs;
+    uint64_t maxNs;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+typedef struct _Histogram Histogram;
+
+
+// The timing of every phase of the frame.
+struct _Timing {
+    bool enabled;
+    Histogram phases[PHASE_COUNT];
+};
+typedef struct _Timing Timing;
+
+
+// How long each stage of startup took.
+struct _Startup {
+    uint64_t startNs;  // when main() was entered.
+    uint64_t lastNs;  // when the last stage ended.
+    uint64_t stageNs[STARTUP_COUNT];
+};
+typedef struct _Startup Startup;
+
+
+// How evenly the frames came: the intervals between them, whatever the
+// timing is enabled for.  A frame is late when it comes more than half a
+// frame period after it was due, so at least one refresh went by without
+// it; the largest stall is the longest interval.
+struct _Pacing {
+    uint32_t framePeriodMs;
+    uint64_t lastNs;  // when the last frame started, or 0 after a wait.
+    Histogram intervals;
+    uint32_t lateFrames;
+    uint32_t droppedTicks;  // ticks given up as too far behind to catch up.
+};
+typedef struct _Pacing Pacing;
+
+
+// The short name of each phase, as used in the CSV and the overlay.
+extern const char* phaseNames[PHASE_COUNT];
+
+// The short name of each startup stage.
+extern const char* startupNames[STARTUP_COUNT];
+
+// Return the nanoseconds elapsed since an arbitrary point.
+uint64_t timingNow(void);
+
+// Reset a histogram.
+void histogramInit(Histogram* histogramp);
+
+// Add a sample to a histogram.
+void histogramAdd(Histogram* histogramp, uint64_t ns);
+
+// Return the duration below which the given fraction of samples fall.
+uint64_t histogramPercentile(Histogram* histogramp, double fraction);
+
+// Reset all the histograms.  Nothing is recorded unless enabled.
+void timingInit(Timing* timingp, bool enabled);
+
+// Start timing a phase.  Returns the start time to pass to timingStop().
+uint64_t timingStart(Timing* timingp);
+
+// Record the time spent in a phase since timingStart().
+void timingStop(Timing* timingp, int phase, uint64_t startNs);
+
+// Write min/avg/percentiles/max of every phase to a CSV file.  Returns false
+// if the file can't be written.
+bool timingWriteCsv(Timing* timingp, const char* path);
+
+// Start timing startup, from startNs.
+void startupInit(Startup* startupp, uint64_t startNs);
+
+// Record that a stage of startup has just ended.
+void startupMark(Startup* startupp, int stage);
+
+// Print the time of every stage, and the time from main() to the first
+// frame.
+void startupPrint(Startup* startupp);
+
+// Start measuring the pacing of frames due every framePeriodMs.
+void pacingInit(Pacing* pacingp, uint32_t framePeriodMs);
+
+// Record that a frame has started at nowNs.
+void pacingFrame(Pacing* pacingp, uint64_t nowNs);
+
+// Forget the last frame, after waiting on purpose: the next interval would
+// not be a stall.
+void pacingResume(Pacing* pacingp);
+
+// Record that ticks were given up.
+void pacingDrop(Pacing* pacingp, uint32_t ticks);
+
+// Print one line of totals.
+void pacingPrint(Pacing* pacingp);
+
+// Write the totals and the histogram of intervals to a text file.  Returns
+// false if the file can't be written.
+bool pacingWrite(Pacing* pacingp, const char* path);
+
+#endif
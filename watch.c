@@ -0,0 +1,287 @@
+// Telemetry viewer: rebuilds a game streamed with --telemetry and shows it.
+// Copyright 2024 whatware
+// Released under the terms of the MIT license
+// See https://opensource.org/licenses/MIT
+
+// Code style:
+// - camelCase for identifiers.
+// - 'p' suffix used for pointers.
+
+// The viewer keeps its own copy of the board, built from the last keyframe
+// and every delta since.  When a keyframe comes straight after a tick the
+// viewer already has, the body it carries is checked against the one built
+// from the deltas, so a run with a packet count doubles as a test of the
+// stream.
+
+#include "engine.h"
+#include "snapshot.h"
+#include "telemetry.h"
+
+#include <stdint.h>  // uint8_t
+#include <stdio.h>  // printf
+#include <stdlib.h>  // atoi, malloc, free
+#include <string.h>  // memcmp, memset, strchr
+#include <unistd.h>  // close
+#include <sys/socket.h>  // socket, bind, recv
+#include <netinet/in.h>  // sockaddr_in
+#include <arpa/inet.h>  // inet_pton, htons
+
+#define DEFAULT_ADDRESS "127.0.0.1"  // only this machine, unless told otherwise.
+#define DEFAULT_PORT 7770
+
+
+// The board as the viewer has rebuilt it.
+struct _View {
+    uint8_t gridWidth;
+    uint8_t gridHeight;
+    uint8_t* occupiedp;  // per cell, non-zero if the snake covers it.
+    SnakeNode* bodyp;  // the blocks, from the head at headAt round to the tail.
+    size_t capacity;
+    size_t headAt;
+    size_t length;
+    Food food;
+    bool synced;  // the view is up to date as of tick.
+    bool crashed;
+    uint32_t tick;
+
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t keyframes;
+    uint64_t checked;  // keyframes checked against the deltas before them.
+    uint64_t desyncs;  // ... which didn't agree.
+    uint64_t lost;  // times a delta was missing, and the view had to wait.
+};
+typedef struct _View View;
+
+
+// Return the block i places back from the head.
+SnakeNode* bodyAt(View* viewp, size_t i) {
+    return &(viewp->bodyp[(viewp->headAt + i) % viewp->capacity]);
+}
+
+
+// Make room for a board of another size.
+void resizeView(View* viewp, uint8_t gridWidth, uint8_t gridHeight) {
+    if (viewp->gridWidth == gridWidth && viewp->gridHeight == gridHeight) {
+        return;
+    }
+    free(viewp->occupiedp);
+    free(viewp->bodyp);
+    viewp->gridWidth = gridWidth;
+    viewp->gridHeight = gridHeight;
+    viewp->capacity = (size_t)gridWidth * gridHeight + 1;
+    viewp->occupiedp = calloc(viewp->capacity, 1);
+    viewp->bodyp = calloc(viewp->capacity, sizeof(SnakeNode));
+    assert(viewp->occupiedp != NULL && viewp->bodyp != NULL);
+}
+
+
+// Is a cell on a board of this size?  Every coordinate in a packet is checked
+// before it is used, since anyone can send one.
+bool onBoard(uint8_t gridWidth, uint8_t gridHeight, Coord x, Coord y) {
+    return x < gridWidth && y < gridHeight;
+}
+
+
+// Rebuild the board from a keyframe.  Returns false if it isn't one, or it
+// has a block or the food off the board.
+bool applyKeyframe(View* viewp, const uint8_t* datap, size_t size) {
+    if (size < SNAPSHOT_HEADER_SIZE || memcmp(datap, "SNKS", 4) != 0 || datap[4] != SNAPSHOT_VERSION) {
+        return false;
+    }
+    uint8_t gridWidth = datap[5];
+    uint8_t gridHeight = datap[6];
+    size_t length = datap[8] | (datap[9] << 8);
+    if (gridWidth == 0 || gridHeight == 0 || length == 0 || length > (size_t)gridWidth * gridHeight ||
+        size < SNAPSHOT_HEADER_SIZE + (length + 2) / 4) {
+        return false;
+    }
+    uint32_t tick = datap[20] | (datap[21] << 8) | (datap[22] << 16) | ((uint32_t)datap[23] << 24);
+
+    // lay the body out from the head, along the links.
+    SnakeNode* blocksp = malloc(length * sizeof(SnakeNode));
+    assert(blocksp != NULL);
+    blocksp[0].x = datap[10];
+    blocksp[0].y = datap[11];
+    const uint8_t* linksp = datap + SNAPSHOT_HEADER_SIZE;
+    for (size_t i = 1; i < length; i++) {
+        uint8_t direction = ((linksp[(i - 1) / 4] >> (2 * ((i - 1) % 4))) & 3) + 1;
+        // on a level which wraps round, a link may lead off the edge: step
+        // in an int, which a 255 cell side can't overflow.
+        int x = blocksp[i - 1].x + (direction == RIGHT) - (direction == LEFT);
+        int y = blocksp[i - 1].y + (direction == DOWN) - (direction == UP);
+        blocksp[i].x = (x + gridWidth) % gridWidth;
+        blocksp[i].y = (y + gridHeight) % gridHeight;
+    }
+    bool valid = onBoard(gridWidth, gridHeight, datap[12], datap[13]);
+    for (size_t i = 0; valid && i < length; i++) {
+        valid = onBoard(gridWidth, gridHeight, blocksp[i].x, blocksp[i].y);
+    }
+    if (valid == false) {
+        free(blocksp);
+        return false;
+    }
+
+    // straight after a tick the view already has, everything but the new
+    // head must be the body as of that tick.
+    if (viewp->synced && viewp->crashed == false && tick == viewp->tick + 1 &&
+        gridWidth == viewp->gridWidth && gridHeight == viewp->gridHeight) {
+        viewp->checked++;
+        bool same = length <= viewp->length + 1;
+        for (size_t i = 1; same && i < length; i++) {
+            SnakeNode* nodep = bodyAt(viewp, i - 1);
+            same = nodep->x == blocksp[i].x && nodep->y == blocksp[i].y;
+        }
+        if (same == false) {
+            viewp->desyncs++;
+        }
+    }
+
+    resizeView(viewp, gridWidth, gridHeight);
+    memset(viewp->occupiedp, 0, viewp->capacity);
+    viewp->headAt = 0;
+    viewp->length = length;
+    for (size_t i = 0; i < length; i++) {
+        viewp->bodyp[i] = blocksp[i];
+        viewp->occupiedp[blocksp[i].y * gridWidth + blocksp[i].x] = 1;
+    }
+    free(blocksp);
+    viewp->food.x = datap[12];
+    viewp->food.y = datap[13];
+    viewp->tick = tick;
+    viewp->crashed = false;
+    viewp->synced = true;
+    viewp->keyframes++;
+    return true;
+}
+
+
+// Move the view on by a delta.  Deltas are ignored until a keyframe comes,
+// and after one goes missing.  One with the head or the food off the board is
+// dropped, which the next delta then counts as missing.
+void applyDelta(View* viewp, const uint8_t* datap, size_t size) {
+    uint8_t flags = datap[0];
+    if (viewp->synced == false || size < 5 || ((flags & TELEMETRY_FOOD) && size < 7)) {
+        return;
+    }
+    uint16_t tick = datap[1] | (datap[2] << 8);
+    if (onBoard(viewp->gridWidth, viewp->gridHeight, datap[3], datap[4]) == false ||
+        ((flags & TELEMETRY_FOOD) && onBoard(viewp->gridWidth, viewp->gridHeight, datap[5], datap[6]) == false)) {
+        return;
+    }
+    if (tick != (uint16_t)(viewp->tick + 1)) {
+        viewp->lost++;
+        viewp->synced = false;
+        return;
+    }
+    viewp->tick++;
+    uint8_t gridWidth = viewp->gridWidth;
+    if (flags & TELEMETRY_CRASHED) {
+        // the game leaves a crashed snake where it was; take the head from
+        // the delta all the same, so that the crash is drawn where it is.
+        SnakeNode* headp = bodyAt(viewp, 0);
+        headp->x = datap[3];
+        headp->y = datap[4];
+        viewp->occupiedp[headp->y * gridWidth + headp->x] = 1;
+        viewp->crashed = true;
+        return;
+    }
+    if ((flags & TELEMETRY_GREW) == 0) {
+        // the tail leaves first: the head may move into its cell.
+        SnakeNode* tailp = bodyAt(viewp, viewp->length - 1);
+        viewp->occupiedp[tailp->y * gridWidth + tailp->x] = 0;
+        viewp->length--;
+    }
+    viewp->headAt = (viewp->headAt + viewp->capacity - 1) % viewp->capacity;
+    viewp->length++;
+    SnakeNode* headp = bodyAt(viewp, 0);
+    headp->x = datap[3];
+    headp->y = datap[4];
+    viewp->occupiedp[headp->y * gridWidth + headp->x] = 1;
+    if (flags & TELEMETRY_FOOD) {
+        viewp->food.x = datap[5];
+        viewp->food.y = datap[6];
+    }
+}
+
+
+// Draw the board on the terminal, over the last one.
+void drawView(View* viewp) {
+    printf("\033[H\033[2J");
+    SnakeNode* headp = bodyAt(viewp, 0);
+    for (int y = 0; y < viewp->gridHeight; y++) {
+        for (int x = 0; x < viewp->gridWidth; x++) {
+            char c = '.';
+            if (headp->x == x && headp->y == y) {
+                c = viewp->crashed ? 'X' : '@';
+            } else if (viewp->occupiedp[y * viewp->gridWidth + x]) {
+                c = 'o';
+            } else if (viewp->food.x == x && viewp->food.y == y) {
+                c = '*';
+            }
+            putchar(c);
+        }
+        putchar('\n');
+    }
+    printf("tick %u, length %zu%s\n", viewp->tick, viewp->length, viewp->synced ? "" : " (waiting for a keyframe)");
+    fflush(stdout);
+}
+
+
+// The viewer entry point: listen for a stream, and draw the board after
+// every packet.  Given a packet count, draw nothing, stop after that many
+// and print what came in.  It listens on the loopback address unless given
+// another, such as 0.0.0.0 for a game on another machine.
+// usage: snake-watch [[address:]port [packets]]
+int main(int argc, char** argv) {
+    char host[64] = DEFAULT_ADDRESS;
+    unsigned int port = DEFAULT_PORT;
+    if (argc > 1 && strchr(argv[1], ':') == NULL) {
+        port = atoi(argv[1]);
+    } else if (argc > 1 && sscanf(argv[1], "%63[0-9.]:%u", host, &port) != 2) {
+        port = 0;
+    }
+    uint64_t maxPackets = argc > 2 ? strtoull(argv[2], NULL, 0) : 0;
+    struct sockaddr_in at;
+    memset(&at, 0, sizeof(at));
+    at.sin_family = AF_INET;
+    at.sin_port = htons(port);
+    if (port == 0 || port > 65535 || inet_pton(AF_INET, host, &(at.sin_addr)) != 1) {
+        fprintf(stderr, "bad address %s\n", argv[1]);
+        return 1;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    assert(fd >= 0);
+    if (bind(fd, (struct sockaddr*)&at, sizeof(at)) != 0) {
+        fprintf(stderr, "can't listen on %s:%u\n", host, port);
+        return 1;
+    }
+
+    View view;
+    memset(&view, 0, sizeof(view));
+    uint8_t buf[TELEMETRY_MAX_PACKET];
+    while (maxPackets == 0 || view.packets < maxPackets) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            continue;
+        }
+        view.packets++;
+        view.bytes += n;
+        if (buf[0] == TELEMETRY_KEYFRAME) {
+            applyKeyframe(&view, buf + 1, n - 1);
+        } else {
+            applyDelta(&view, buf, n);
+        }
+        if (maxPackets == 0 && view.gridWidth > 0) {
+            drawView(&view);
+        }
+    }
+    printf("packets: %llu, %.1f bytes each\n", (unsigned long long)view.packets, (double)view.bytes / view.packets);
+    printf("keyframes: %llu, %llu checked against the deltas, %llu disagreed\n",
+        (unsigned long long)view.keyframes, (unsigned long long)view.checked, (unsigned long long)view.desyncs);
+    printf("lost: %llu\n", (unsigned long long)view.lost);
+    close(fd);
+    free(view.occupiedp);
+    free(view.bodyp);
+    return view.desyncs > 0;
+}